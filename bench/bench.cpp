@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../tests/allocation_counter.h"
+#include "engine/board.h"
+#include "heuristic/forward.h"
+#include "serialization.h"
+#include "utils.h"
+
+using sudoku_engine::Board;
+using sudoku_engine::BoardCage;
+using sudoku_engine::BoardCell;
+using sudoku_engine::BoardCellDomain;
+using sudoku_engine::BoardPosition;
+using sudoku_engine::BoardState;
+using sudoku_engine::ForwardHeuristic;
+using sudoku_engine::serialization::MappedPuzzleLoader;
+using sudoku_engine::serialization::PuzzleLoader;
+using sudoku_engine::test::allocation_count;
+
+// Keeps the compiler from optimizing away a result nobody reads
+template <class T>
+static void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+}
+
+// Exposes the parts of the forward checker that are measured
+class BenchForwardHeuristic : public ForwardHeuristic {
+public:
+    BenchForwardHeuristic(Board& board)
+        : ForwardHeuristic(
+              board,
+              std::numeric_limits<std::size_t>::max(),
+              true,
+              ValueOrder::NATURAL,
+              RestartPolicy()
+          ) {}
+
+    using ForwardHeuristic::applyValue;
+    using ForwardHeuristic::getTrailMark;
+    using ForwardHeuristic::getValidCageValues;
+    using ForwardHeuristic::selectCell;
+    using ForwardHeuristic::undoValue;
+
+    const BoardState<BoardCellDomain>& getDomains() const {
+        return this->cell_domains;
+    }
+};
+
+// A board part way through a solve: the solution placed through the forward
+// checker in random order, until only some of the cells are left
+struct Fixture {
+    std::vector<BoardCage> cages;
+    Board board;
+    BenchForwardHeuristic heuristic;
+    std::vector<BoardPosition> empty_cells;
+
+    Fixture(
+        const MappedPuzzleLoader& loader,
+        std::size_t index,
+        double fill_ratio,
+        sudoku_engine::utils::Random& random
+    )
+        : heuristic(board) {
+        const auto puzzle = loader.view_puzzle(index);
+        puzzle.decode_cages(this->cages);
+        BoardState<BoardCell> solution(
+            sudoku_engine::BOARD_SIZE, sudoku_engine::CELL_EMPTY
+        );
+        puzzle.decode_solution(solution);
+
+        this->board.setCages(this->cages);
+        this->board.clearValues();
+        this->heuristic.reset();
+
+        std::vector<BoardPosition> cells;
+        using sudoku_engine::BoardOffset;
+        for (BoardOffset row = 0; row < sudoku_engine::BOARD_SIZE; row++) {
+            for (BoardOffset col = 0; col < sudoku_engine::BOARD_SIZE; col++) {
+                cells.emplace_back(row, col);
+            }
+        }
+        random.shuffle(std::span<BoardPosition>(cells));
+
+        const auto fill_count =
+            static_cast<std::size_t>(cells.size() * fill_ratio);
+        for (std::size_t i = 0; i < cells.size(); i++) {
+            if (i < fill_count) {
+                this->heuristic.applyValue(cells[i], solution[cells[i]]);
+            } else {
+                this->empty_cells.push_back(cells[i]);
+            }
+        }
+    }
+};
+
+struct BenchResult {
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+struct BenchOptions {
+    std::chrono::milliseconds min_time{200};
+    std::string filter;
+};
+
+// Runs op(i) for i = 0, 1, ... over several timed samples, and reports the
+// median sample
+static BenchResult runBenchmark(
+    const BenchOptions& options,
+    const std::function<void(std::size_t)>& op
+) {
+    using Clock = std::chrono::steady_clock;
+    constexpr std::size_t SAMPLE_COUNT = 5;
+
+    const auto time_batch = [&](std::size_t iterations) {
+        const auto start = Clock::now();
+        for (std::size_t i = 0; i < iterations; i++) {
+            op(i);
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count();
+    };
+
+    // Grow the batch until one takes a sample's share of the time
+    const double sample_ns =
+        std::chrono::duration<double, std::nano>(options.min_time).count() /
+        SAMPLE_COUNT;
+    std::size_t iterations = 1;
+    while (true) {
+        const double elapsed = time_batch(iterations);
+        if (elapsed >= sample_ns) {
+            break;
+        }
+        const double scale = elapsed > 0 ? sample_ns / elapsed : 16;
+        iterations = static_cast<std::size_t>(
+            iterations * std::clamp(scale * 1.2, 2.0, 16.0)
+        );
+    }
+
+    std::vector<double> samples;
+    samples.reserve(SAMPLE_COUNT);
+    std::size_t allocations = 0;
+    for (std::size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const std::size_t allocations_before = allocation_count;
+        samples.push_back(time_batch(iterations) / iterations);
+        allocations += allocation_count - allocations_before;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    return {
+        .ns_per_op = samples[SAMPLE_COUNT / 2],
+        .allocations_per_op =
+            allocations / static_cast<double>(SAMPLE_COUNT * iterations)
+    };
+}
+
+static void printHelp(std::string_view exe_name) {
+    std::cout << "Usage: " << exe_name << " [puzzle_bundle_file.ks ...]"
+              << " [--filter name] [--min-time milliseconds]" << std::endl;
+    std::cout << "Bundles default to cage-le-2, cage-le-5 and cage-le-9 from "
+              << SUDOKU_BENCH_DATA_DIR << std::endl;
+}
+
+// Benchmarks on the boards of one bundle
+static void benchBundle(
+    const std::string& filename,
+    const BenchOptions& options
+) {
+    // Few enough to stay in cache, enough to vary the boards
+    constexpr std::size_t FIXTURE_COUNT = 32;
+    constexpr double FILL_RATIO = 0.4;
+
+    const MappedPuzzleLoader loader(filename);
+    sudoku_engine::utils::Random random(1);
+
+    std::vector<std::unique_ptr<Fixture>> fixtures;
+    for (std::size_t i = 0; i < FIXTURE_COUNT && i < loader.puzzle_count();
+         i++) {
+        fixtures.push_back(
+            std::make_unique<Fixture>(loader, i, FILL_RATIO, random)
+        );
+    }
+    if (fixtures.empty()) {
+        std::cout << "No puzzles in \"" << filename << '"' << std::endl;
+        return;
+    }
+
+    // Cell and value pairs to try, in a fixed random order
+    struct Query {
+        Fixture* fixture;
+        BoardPosition pos;
+        BoardCell value;
+    };
+    std::vector<Query> queries;
+    std::vector<Query> legal_queries;
+    std::vector<std::pair<Fixture*, const BoardCage*>> cages;
+    std::vector<BoardCellDomain> domains;
+    for (const auto& fixture : fixtures) {
+        for (const BoardPosition& pos : fixture->empty_cells) {
+            const BoardCellDomain domain = fixture->heuristic.getDomains()[pos];
+            domains.push_back(domain);
+            for (BoardCell value = sudoku_engine::CELL_MIN;
+                 value <= sudoku_engine::CELL_MAX;
+                 value++) {
+                queries.push_back({fixture.get(), pos, value});
+                if (domain.has(value) &&
+                    !fixture->board.isInvalid(pos, value)) {
+                    legal_queries.push_back({fixture.get(), pos, value});
+                }
+            }
+        }
+        for (const BoardCage& cage : fixture->cages) {
+            cages.emplace_back(fixture.get(), &cage);
+        }
+    }
+    random.shuffle(std::span<Query>(queries));
+    random.shuffle(std::span<Query>(legal_queries));
+
+    // The bundle, in memory so that disk reads aren't measured
+    std::ifstream file(filename, std::ios::binary);
+    const std::string bundle(
+        (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()
+    );
+    std::istringstream bundle_stream(bundle);
+    PuzzleLoader stream_loader(bundle_stream);
+
+    std::vector<BoardCage> decoded_cages;
+    BoardState<BoardCell> decoded_solution(
+        sudoku_engine::BOARD_SIZE, sudoku_engine::CELL_EMPTY
+    );
+
+    const std::vector<
+        std::pair<std::string_view, std::function<void(std::size_t)>>>
+        benchmarks = {
+            {"Board::isInvalid(pos, value)",
+             [&](std::size_t i) {
+                 const Query& query = queries[i % queries.size()];
+                 keep(query.fixture->board.isInvalid(query.pos, query.value));
+             }},
+            {"Board::isInvalidCage",
+             [&](std::size_t i) {
+                 const auto& [fixture, cage] = cages[i % cages.size()];
+                 keep(fixture->board.isInvalidCage(*cage));
+             }},
+            {"ForwardHeuristic::forwardCheck",
+             [&](std::size_t i) {
+                 // Placing a value is little more than the check, and
+                 // undoing it puts the fixture back as it was
+                 const Query& query = legal_queries[i % legal_queries.size()];
+                 auto& heuristic = query.fixture->heuristic;
+                 const std::size_t mark = heuristic.getTrailMark();
+                 keep(heuristic.applyValue(query.pos, query.value));
+                 heuristic.undoValue(query.pos, mark);
+             }},
+            {"ForwardHeuristic::getValidCageValues",
+             [&](std::size_t i) {
+                 const auto& [fixture, cage] = cages[i % cages.size()];
+                 keep(fixture->heuristic.getValidCageValues(*cage));
+             }},
+            {"ForwardHeuristic::findMrvCell",
+             [&](std::size_t i) {
+                 keep(fixtures[i % fixtures.size()]->heuristic.selectCell());
+             }},
+            {"PuzzleLoader::load_puzzle",
+             [&](std::size_t i) {
+                 keep(stream_loader.load_puzzle(i % loader.puzzle_count()));
+             }},
+            {"MappedPuzzleLoader::view_puzzle + decode",
+             [&](std::size_t i) {
+                 const auto view =
+                     loader.view_puzzle(i % loader.puzzle_count());
+                 view.decode_cages(decoded_cages);
+                 view.decode_solution(decoded_solution);
+                 keep(decoded_cages.data());
+             }},
+            {"BoardCellDomain::has",
+             [&](std::size_t i) {
+                 const BoardCellDomain& domain = domains[i % domains.size()];
+                 keep(domain.has(BoardCell(i % 9 + 1)));
+             }},
+            {"BoardCellDomain::remove + size",
+             [&](std::size_t i) {
+                 BoardCellDomain domain = domains[i % domains.size()];
+                 domain.remove(BoardCell(i % 9 + 1));
+                 keep(domain.size());
+             }},
+            {"BoardCellDomain::operator&",
+             [&](std::size_t i) {
+                 keep(
+                     domains[i % domains.size()] &
+                     domains[(i + 1) % domains.size()]
+                 );
+             }},
+        };
+
+    std::cout << std::endl << filename << std::endl;
+    std::cout << std::left << std::setw(44) << "Benchmark" << std::right
+              << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op"
+              << std::endl;
+
+    for (const auto& [name, op] : benchmarks) {
+        if (name.find(options.filter) == name.npos) {
+            continue;
+        }
+
+        const BenchResult result = runBenchmark(options, op);
+        std::cout << std::left << std::setw(44) << name << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(12)
+                  << result.ns_per_op << std::setw(12)
+                  << result.allocations_per_op << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    std::vector<std::string> filenames;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if ((arg == "--filter" || arg == "--min-time") && i + 1 >= argc) {
+            std::cout << "Value required for " << arg << std::endl;
+            return 1;
+        } else if (arg == "--filter") {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time") {
+            options.min_time = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--help") {
+            printHelp(argv[0]);
+            return 0;
+        } else {
+            filenames.emplace_back(arg);
+        }
+    }
+
+    if (filenames.empty()) {
+        for (const char* const name : {"cage-le-2", "cage-le-5", "cage-le-9"}) {
+            filenames.push_back(
+                std::string(SUDOKU_BENCH_DATA_DIR) + '/' + name + ".ks"
+            );
+        }
+    }
+
+    try {
+        for (const std::string& filename : filenames) {
+            benchBundle(filename, options);
+        }
+    } catch (const std::exception& err) {
+        std::cout << "[ERROR] " << err.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
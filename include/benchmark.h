@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "heuristic/heuristic.h"
+
+SUDOKU_NAMESPACE {
+    // Percentiles and totals of one heuristic over one bundle, the unit that
+    // benchmark baselines are kept and compared in
+    struct BenchmarkResult {
+        std::string bundle;
+        std::string heuristic;
+        std::size_t puzzle_count = 0;
+        std::size_t solved_count = 0;
+        // Wall clock seconds per puzzle, the median over the repetitions
+        double p50_time = 0;
+        double p90_time = 0;
+        double p99_time = 0;
+        double max_time = 0;
+        double mean_time = 0;
+        double mean_cpu_time = 0;
+        std::size_t p50_steps = 0;
+        std::size_t p99_steps = 0;
+        std::size_t max_steps = 0;
+        double nodes_per_second = 0;
+    };
+
+    struct BenchmarkOptions {
+        std::size_t step_limit = 10000000;
+        // Puzzles solved untimed first, to warm up caches and the allocator
+        std::size_t warmup_count = 50;
+        // Timed passes over the bundle, each puzzle keeps its median time
+        std::size_t repeat_count = 3;
+        // Only the first puzzles of each bundle, if set
+        std::optional<std::size_t> puzzle_limit;
+        // Percent a metric may get worse by before it counts as a
+        // regression. Times only hold up against a baseline from the same
+        // machine, so they aren't checked unless asked for.
+        std::optional<double> max_time_regression;
+        double max_step_regression = 0;
+    };
+
+    struct BenchmarkHeuristic {
+        using Factory = std::function<std::unique_ptr<Heuristic>(Board&)>;
+
+        // As given on the command line, e.g. "forward-mrv-lcv"
+        std::string name;
+        Factory factory;
+    };
+
+    // Results as CSV, one row per bundle and heuristic
+    void writeBenchmarkResults(
+        std::ostream& output,
+        std::span<const BenchmarkResult> results
+    );
+    std::vector<BenchmarkResult> readBenchmarkResults(std::istream& input);
+
+    // Solves the puzzles of one bundle with one heuristic, one at a time on
+    // the calling thread so runs are comparable
+    BenchmarkResult benchmarkBundle(
+        const std::string& filename,
+        const BenchmarkHeuristic& heuristic,
+        const BenchmarkOptions& options
+    );
+
+    // Benchmarks every bundle with every heuristic, printing a table row
+    // for each as it finishes
+    std::vector<BenchmarkResult> runBenchmarks(
+        std::span<const std::string> bundles,
+        std::span<const BenchmarkHeuristic> heuristics,
+        const BenchmarkOptions& options,
+        std::ostream& output
+    );
+
+    // Reports every metric that got worse than the baseline allows, returns
+    // whether there were any
+    bool compareBenchmarkResults(
+        std::span<const BenchmarkResult> results,
+        std::span<const BenchmarkResult> baseline,
+        const BenchmarkOptions& options,
+        std::ostream& output
+    );
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "engine/generator.h"
+#include "serialization.h"
+
+SUDOKU_NAMESPACE {
+    struct BundleGeneratorOptions {
+        GeneratorOptions generator;
+        std::uint32_t puzzle_count = 0;
+        std::size_t thread_count = 1;
+        // Every puzzle draws its seeds from this and its index, so the
+        // bundle is the same whatever the thread count
+        std::uint64_t seed = 0;
+        // Seeds tried for one puzzle before the whole bundle is given up on
+        std::size_t max_attempts = 100;
+    };
+
+    // Generates a bundle of unique puzzles and writes it in index order as
+    // the puzzles are done, so a text bundle going down a pipe can be
+    // solved meanwhile. Prints a summary to the log, and throws if a puzzle
+    // runs out of attempts.
+    void generateBundle(
+        const BundleGeneratorOptions& options,
+        std::ostream& output,
+        serialization::BundleFormat format,
+        std::ostream& log
+    );
+
+    // Rewrites every puzzle of the bundle in the given format
+    void convertBundle(
+        const serialization::MappedPuzzleLoader& loader,
+        std::ostream& output,
+        serialization::BundleFormat format
+    );
+}
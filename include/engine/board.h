@@ -15,14 +15,35 @@
 SUDOKU_NAMESPACE {
     constexpr int BOARD_SIZE = 9;
     constexpr int BOX_SIZE = 3;
+    // Cells sharing a row, column or box with a given cell
+    constexpr int PEER_COUNT =
+        2 * (BOARD_SIZE - 1) + (BOX_SIZE - 1) * (BOX_SIZE - 1);
 
     using BoardCell = std::uint8_t;
     using BoardOffset = std::uint16_t;
+    // Bit (value - 1) is set for each value present
+    using BoardCellMask = std::uint16_t;
 
     constexpr BoardCell CELL_EMPTY = 0;
     constexpr BoardCell CELL_MIN = 1;
     constexpr BoardCell CELL_MAX = 9;
 
+    constexpr BoardCellMask toCellMask(BoardCell value) {
+        return static_cast<BoardCellMask>(1u << (value - CELL_MIN));
+    }
+
+    // Values in [low, high], clamped to the valid cell range
+    constexpr BoardCellMask toCellRangeMask(int low, int high) {
+        low = low < CELL_MIN ? CELL_MIN : low;
+        high = high > CELL_MAX ? CELL_MAX : high;
+        if (low > high) {
+            return 0;
+        }
+        return static_cast<BoardCellMask>(
+            (1u << (high - CELL_MIN + 1)) - (1u << (low - CELL_MIN))
+        );
+    }
+
     struct BoardPosition {
         BoardOffset row;
         BoardOffset col;
@@ -58,6 +79,16 @@ SUDOKU_NAMESPACE {
             : cells(std::move(cells)), sum(sum) {}
     };
 
+    // Sum over a set of cells implied by the rule that every row, column
+    // and box adds up to 45 (the "innies" or "outies" of a region). Unlike a
+    // cage, its cells may repeat values unless it is marked distinct.
+    struct DerivedSum {
+        std::vector<BoardPosition> cells;
+        unsigned sum;
+        // All cells share a row, column, box or cage
+        bool distinct;
+    };
+
     class BoardCellDomain {
     private:
         std::bitset<BOARD_SIZE> exists;
@@ -71,6 +102,17 @@ SUDOKU_NAMESPACE {
             }
         }
 
+        static BoardCellDomain fromMask(BoardCellMask mask) {
+            BoardCellDomain result;
+            result.exists = std::bitset<BOARD_SIZE>(mask);
+            return result;
+        }
+
+        [[nodiscard]]
+        BoardCellMask toMask() const {
+            return static_cast<BoardCellMask>(this->exists.to_ulong());
+        }
+
         void add(BoardCell value) {
             this->check(value);
             this->exists.set(value - 1, true);
@@ -184,37 +226,132 @@ SUDOKU_NAMESPACE {
     class Board {
     public:
         using LineOrBox = std::array<BoardPosition, BOARD_SIZE>;
+        using Peers = std::array<BoardPosition, PEER_COUNT>;
+
+        // Running totals of a cage or derived sum, kept in sync by
+        // setValue/clearValue. The used mask is only meaningful for sums
+        // whose values are distinct.
+        struct CageState {
+            BoardCellMask used;
+            unsigned sum;
+            BoardOffset empty_count;
+        };
+
+        using DerivedIndex = std::uint16_t;
+
+        // Derived sums are only kept for sets of at most this many cells,
+        // larger ones prune too little to pay for their upkeep
+        static constexpr std::size_t MAX_DERIVED_CELLS = 6;
+        static constexpr std::size_t MAX_DERIVED_SUMS = 256;
 
     private:
+        using UnitMasks = std::array<BoardCellMask, BOARD_SIZE>;
+
         BoardState<BoardCell> cell_values;
         BoardState<const BoardCage*> cell_cages;
         std::span<const BoardCage> cages;
 
+        // Digits used by each row, column and box. These assume that every
+        // placement went through isInvalid(pos, value) first; setValues()
+        // rebuilds them from scratch for arbitrary states.
+        UnitMasks row_used;
+        UnitMasks col_used;
+        UnitMasks box_used;
+        std::vector<CageState> cage_states;
+        BoardOffset empty_count;
+
+        std::vector<DerivedSum> derived_sums;
+        std::vector<CageState> derived_states;
+        // Derived sums each cell is part of, flattened; the ones for the
+        // cell at offset i start at cell_derived_start[i]
+        std::vector<DerivedIndex> cell_derived;
+        std::array<std::uint16_t, BOARD_SIZE * BOARD_SIZE + 1>
+            cell_derived_start;
+
     public:
         Board()
             : cell_values(BOARD_SIZE, CELL_EMPTY),
-              cell_cages(BOARD_SIZE, nullptr) {}
+              cell_cages(BOARD_SIZE, nullptr), row_used(), col_used(),
+              box_used(), empty_count(BOARD_SIZE * BOARD_SIZE),
+              cell_derived_start() {}
 
-        BoardState<BoardCell>& getValues() {
+        const BoardState<BoardCell>& getValues() const {
             return this->cell_values;
         }
 
         void setValues(BoardState<BoardCell> state) {
             this->cell_values = std::move(state);
+            this->rebuildUnitState();
         }
 
+        // Empty every cell, keeping the cages
+        void clearValues() {
+            this->cell_values.reset(CELL_EMPTY);
+            this->rebuildUnitState();
+        }
+
+        void setValue(const BoardPosition& pos, BoardCell value);
+        void clearValue(const BoardPosition& pos);
+
         void setCages(const std::span<const BoardCage>& cages);
 
+        // Full scan, meant for verifying finished boards
         bool isInvalid() const;
-        bool isInvalid(const BoardPosition& pos) const;
+
+        // Whether placing value at the empty cell pos would break a
+        // constraint, checked against the unit masks in constant time
+        bool isInvalid(const BoardPosition& pos, BoardCell value) const;
+
+        // Whether the cage repeats a digit, or its sum can no longer be
+        // reached. Part of the full scan, but also checked on its own.
+        bool isInvalidCage(const BoardCage& cage) const;
 
         bool isIncomplete() const {
-            return this->cell_values.contains(0);
+            return this->empty_count != 0;
+        }
+
+        BoardCellMask getUsedMask(const BoardPosition& pos) const {
+            return this->row_used[pos.row] | this->col_used[pos.col] |
+                   this->box_used[this->getCellBox(pos)];
+        }
+
+        std::span<const BoardCage> getCages() const {
+            return this->cages;
+        }
+
+        std::size_t getCageIndex(const BoardCage& cage) const {
+            return static_cast<std::size_t>(&cage - this->cages.data());
+        }
+
+        const CageState& getCageState(const BoardCage& cage) const {
+            return this->cage_states[this->getCageIndex(cage)];
+        }
+
+        std::span<const DerivedSum> getDerivedSums() const {
+            return this->derived_sums;
+        }
+
+        const CageState& getDerivedState(std::size_t index) const {
+            return this->derived_states[index];
+        }
+
+        // Indices of the derived sums that include pos
+        std::span<const DerivedIndex> getCellDerivedSums(
+            const BoardPosition& pos
+        ) const {
+            const std::size_t offset = pos.toOffset();
+            return std::span(this->cell_derived)
+                .subspan(
+                    this->cell_derived_start[offset],
+                    this->cell_derived_start[offset + 1] -
+                        this->cell_derived_start[offset]
+                );
         }
 
         const LineOrBox& getRow(BoardOffset index) const;
         const LineOrBox& getCol(BoardOffset index) const;
         const LineOrBox& getBox(BoardOffset index) const;
+        const Peers& getPeers(const BoardPosition& pos) const;
 
         constexpr BoardOffset getCellBox(const BoardPosition& pos) const {
             return (pos.row / BOX_SIZE) * BOX_SIZE + (pos.col / BOX_SIZE);
@@ -227,14 +364,21 @@ SUDOKU_NAMESPACE {
         void print(std::ostream& output) const;
 
     private:
+        void rebuildUnitState();
+        void deriveSums();
+
+        static bool breaksSum(
+            const CageState& state,
+            unsigned target,
+            BoardCell value
+        );
+
         bool hasInvalidLines() const;
         bool hasInvalidBoxes() const;
         bool hasInvalidCages() const;
 
         bool isInvalidLineOrBox(const LineOrBox& cells) const;
 
-        bool isInvalidCage(const BoardCage& cage) const;
-
         bool isInvalidRow(BoardOffset row) const {
             return this->isInvalidLineOrBox(this->getRow(row));
         }
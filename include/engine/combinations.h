@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+
+#include "board.h"
+
+SUDOKU_NAMESPACE {
+    // Exact killer cage candidates: for a remaining sum, a number of empty
+    // cells and the digits already used in the cage, the union of every set
+    // of distinct unused digits of that size adding up to the sum.
+    class CageCombinations {
+    public:
+        static constexpr unsigned MAX_SUM = 45;
+        static constexpr std::size_t MASK_COUNT = std::size_t(1) << BOARD_SIZE;
+        static constexpr std::size_t TABLE_SIZE =
+            (MAX_SUM + 1) * (BOARD_SIZE + 1) * MASK_COUNT;
+
+        using Table = std::array<BoardCellMask, TABLE_SIZE>;
+
+        static constexpr std::size_t toIndex(
+            unsigned sum,
+            unsigned cells,
+            BoardCellMask used
+        ) {
+            return (sum * (BOARD_SIZE + 1) + cells) * MASK_COUNT + used;
+        }
+
+        // Returns 0 when no combination exists
+        static BoardCellMask candidates(
+            unsigned sum,
+            unsigned cells,
+            BoardCellMask used
+        ) {
+            if (sum > MAX_SUM || cells > BOARD_SIZE) {
+                return 0;
+            }
+            return table[toIndex(sum, cells, used & (MASK_COUNT - 1))];
+        }
+
+    private:
+        static const Table table;
+    };
+}
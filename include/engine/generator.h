@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../heuristic/propagation.h"
+#include "../serialization.h"
+#include "../utils.h"
+#include "board.h"
+
+SUDOKU_NAMESPACE {
+    struct GeneratorOptions {
+        // Largest cage, as in the cage-le-N bundles
+        std::size_t max_cage_size = 5;
+        // Steps each uniqueness check may take, puzzles that need more are
+        // given up on
+        std::size_t step_limit = 100000;
+        // Cage merges tried once the puzzle is unique, each one kept only if
+        // the puzzle stays unique. Fewer, larger cages make harder puzzles,
+        // but every attempt costs a solve.
+        std::size_t merge_attempts = 8;
+    };
+
+    // Builds killer puzzles with exactly one solution: fills a random grid,
+    // cuts it into random cages, splits the cages a second solution gets
+    // through until there is none, then merges cages back together wherever
+    // the solution stays unique. One per thread, it reuses its board and
+    // solver across puzzles.
+    class Generator {
+    private:
+        static constexpr std::size_t CELL_COUNT = BOARD_SIZE * BOARD_SIZE;
+
+        using CellCages = std::array<std::uint8_t, CELL_COUNT>;
+
+        enum class Uniqueness {
+            UNIQUE,
+            // The board holds another solution
+            AMBIGUOUS,
+            // The solver ran out of steps
+            UNKNOWN
+        };
+
+        GeneratorOptions options;
+        utils::Random random;
+
+        std::array<BoardCell, CELL_COUNT> grid;
+        // Cage index of every cell, by offset
+        CellCages cell_cages;
+        std::vector<BoardCage> cages;
+
+        Board board;
+        PropagationHeuristic heuristic;
+
+    public:
+        explicit Generator(GeneratorOptions options);
+
+        // The same seed always gives the same puzzle. Returns nullptr if the
+        // solver couldn't tell in time whether a puzzle is unique.
+        std::unique_ptr<serialization::Puzzle> generate(std::uint64_t seed);
+
+    private:
+        // A random valid grid, by randomized backtracking over bitmasks
+        void fillGrid();
+
+        // Random connected cages of distinct digits, up to the maximum size
+        void partitionCages();
+
+        // Splits the cage of the cell at offset in two, so that the cell no
+        // longer shares it with all of its old cage mates
+        void splitCage(std::size_t offset);
+
+        // Merges two random neighbouring cages, undone if that lets in a
+        // second solution. Returns whether the merge was kept.
+        bool tryMerge();
+
+        // Renumbers cell_cages by connected region, then rebuilds the cages
+        // and hands them to the board
+        void rebuildCages();
+
+        Uniqueness checkUniqueness();
+
+        // Orthogonal neighbours of a cell, returns how many there are
+        static std::size_t getNeighbours(
+            std::size_t offset,
+            std::array<std::size_t, 4>& neighbours
+        );
+    };
+}
@@ -11,6 +11,6 @@ SUDOKU_NAMESPACE {
         Solver();
         ~Solver();
 
-        bool solve(Heuristic& heuristic);
+        SearchStatus solve(Heuristic& heuristic);
     };
 }
@@ -1,30 +1,105 @@
 #pragma once
 
-#include <stdexcept>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
 
 #include "heuristic.h"
+#include "trace.h"
 
 SUDOKU_NAMESPACE {
-    class BacktrackHeuristic : public Heuristic {
+    class SearchPool;
+
+    // Cell and value placed on the way down to a search node
+    struct SearchAssignment {
+        BoardPosition pos;
+        BoardCell value;
+    };
+
+    // Values left to try at a search node, packed four bits per value in the
+    // order they should be tried
+    class CandidateQueue {
+    private:
+        std::uint64_t packed = 0;
+        std::uint8_t count = 0;
+
     public:
-        class TooHardError : public std::runtime_error {
-            using runtime_error::runtime_error;
-        };
+        void push(BoardCell value) {
+            this->packed |= std::uint64_t(value) << (4 * this->count);
+            this->count++;
+        }
+
+        BoardCell pop() {
+            const auto value = static_cast<BoardCell>(this->packed & 0xF);
+            this->packed >>= 4;
+            this->count--;
+            return value;
+        }
+
+        [[nodiscard]]
+        bool empty() const {
+            return this->count == 0;
+        }
 
+        [[nodiscard]]
+        std::uint8_t size() const {
+            return this->count;
+        }
+    };
+
+    class BacktrackHeuristic : public Heuristic {
     protected:
-        std::size_t step_count = 0;
-        std::size_t step_limit;
+        struct SearchFrame {
+            BoardPosition pos;
+            // Value currently placed at pos, or CELL_EMPTY
+            BoardCell value;
+            CandidateQueue candidates;
+            std::size_t trail_mark;
+        };
+
+        static constexpr std::size_t MAX_DEPTH = BOARD_SIZE * BOARD_SIZE;
+
+    private:
+        std::array<SearchFrame, MAX_DEPTH> frames;
+        std::size_t depth = 0;
+
+        // Step count at which the search unwinds and starts over
+        std::size_t restart_step = 0;
+
+        // Only set while taking part in a parallel search
+        SearchPool* pool = nullptr;
+        std::size_t pool_worker = 0;
+        std::span<const SearchAssignment> task_path;
+
+        // Only set while tracing
+        TraceRecorder* trace = nullptr;
 
     public:
         BacktrackHeuristic(Board& board, std::size_t step_limit)
-            : Heuristic(board), step_limit(step_limit) {}
+            : Heuristic(board, step_limit) {}
+
+        SearchStatus solve() override;
 
-        bool solve() override;
+        // Join a parallel search as the given worker: steps count against
+        // the pool's budget, and untried subtrees are handed to the pool
+        // whenever other workers run out of work
+        void setSearchPool(SearchPool* pool, std::size_t worker) {
+            this->pool = pool;
+            this->pool_worker = worker;
+        }
 
-        std::size_t getStepCount() const {
-            return this->step_count;
+        // Record every assignment, prune and backtrack of the following
+        // solves, or stop recording with nullptr
+        void setTraceRecorder(TraceRecorder* trace) {
+            this->trace = trace;
         }
 
+        // Search only below the given assignments. The board is left as it
+        // was if the subtree turns out to have no solution.
+        SearchStatus solveTask(std::span<const SearchAssignment> path);
+
     protected:
         static constexpr BoardPosition incrementPos(const BoardPosition& pos) {
             auto next = BoardPosition(pos.row, pos.col + 1);
@@ -35,12 +110,77 @@ SUDOKU_NAMESPACE {
             return next;
         }
 
-        virtual bool expand(const BoardPosition& pos);
+        // Search hooks, called by the iterative search loop in solve()
+
+        // Next cell to branch on, or a position with row == BOARD_SIZE once
+        // the board is full
+        virtual BoardPosition selectCell() const;
+
+        // Values worth trying at pos, in the order they should be tried
+        virtual CandidateQueue orderValues(const BoardPosition& pos);
+
+        // Place value at pos; on failure the caller still calls undoValue()
+        virtual bool applyValue(const BoardPosition& pos, BoardCell value);
+
+        // Undo applyValue(), restoring the state recorded at trail_mark
+        virtual void undoValue(
+            const BoardPosition& pos,
+            std::size_t trail_mark
+        );
+
+        virtual std::size_t getTrailMark() const {
+            return 0;
+        }
 
-        void checkStepLimit() {
-            if (this->step_count > this->step_limit) {
-                throw TooHardError("Rage quit");
+        // Steps to search before unwinding to the root and starting over,
+        // asked again on every restart. Only worth it for heuristics that
+        // break ties at random, so every run takes a different path.
+        virtual std::size_t getRestartCutoff() {
+            return std::numeric_limits<std::size_t>::max();
+        }
+
+        // Domains to start a trace from, full unless the heuristic keeps any
+        virtual void getTraceDomains(
+            BoardState<BoardCellDomain>& domains
+        ) const;
+
+        void traceEvent(
+            TraceEventType type,
+            const BoardPosition& pos,
+            BoardCell value = CELL_EMPTY,
+            BoardCellMask old_domain = 0,
+            BoardCellMask new_domain = 0
+        ) const {
+            if (this->trace != nullptr) [[unlikely]] {
+                this->trace->record({
+                    .type = type,
+                    .cell = static_cast<std::uint8_t>(pos.toOffset()),
+                    .value = value,
+                    .reserved = 0,
+                    .old_domain = old_domain,
+                    .new_domain = new_domain
+                });
             }
         }
+
+        // Position of the innermost node, if any
+        const BoardPosition* getCurrentPos() const {
+            return this->depth > 0 ? &this->frames[this->depth - 1].pos :
+                                     nullptr;
+        }
+
+    private:
+        // Descend into a new node, returns SOLVED once the board is full,
+        // or why the search has to stop
+        std::optional<SearchStatus> pushFrame();
+
+        // Called with the board full, returns whether to stop searching
+        bool foundSolution();
+
+        void restart();
+        void scheduleRestart();
+
+        bool syncPool();
+        void shareWork();
     };
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "heuristic.h"
+
+SUDOKU_NAMESPACE {
+    // Killer sudoku as an exact cover problem, solved with Algorithm X on
+    // dancing links. Every cell, and every value of each row, column and
+    // box, is a column covered by the options placing a value in a cell.
+    // Each cage adds a column covered by one option per digit combination
+    // adding up to its sum, and a column per digit that is covered either by
+    // a cage cell taking that digit or by a combination leaving it out.
+    class DlxHeuristic final : public Heuristic {
+    private:
+        using NodeIndex = std::uint32_t;
+
+        struct Node {
+            NodeIndex left;
+            NodeIndex right;
+            NodeIndex up;
+            NodeIndex down;
+            NodeIndex column;
+            // Option the node belongs to, unused for column headers
+            NodeIndex option;
+        };
+
+        // Value placed in a cell, or CELL_EMPTY for a cage combination
+        struct Option {
+            BoardPosition pos;
+            BoardCell value;
+        };
+
+        // Column headers follow the root, in the order of their columns
+        static constexpr NodeIndex ROOT = 0;
+
+        static constexpr std::size_t CELL_COUNT = BOARD_SIZE * BOARD_SIZE;
+        static constexpr std::size_t CELL_COLUMNS = 0;
+        static constexpr std::size_t ROW_VALUE_COLUMNS = CELL_COUNT;
+        static constexpr std::size_t COL_VALUE_COLUMNS = 2 * CELL_COUNT;
+        static constexpr std::size_t BOX_VALUE_COLUMNS = 3 * CELL_COUNT;
+        // One column for the cage itself, followed by one per digit
+        static constexpr std::size_t CAGE_COLUMNS = 4 * CELL_COUNT;
+        static constexpr std::size_t COLUMNS_PER_CAGE = 1 + BOARD_SIZE;
+
+        std::vector<Node> nodes;
+        std::vector<NodeIndex> column_sizes;
+        std::vector<Option> options;
+        // Node of the option tried at each depth, or the column header
+        // before the first one
+        std::vector<NodeIndex> chosen;
+
+    public:
+        DlxHeuristic(Board& board, std::size_t step_limit);
+
+        SearchStatus solve() override;
+
+    private:
+        void build();
+        void addOption(
+            const Option& option,
+            std::span<const NodeIndex> columns
+        );
+
+        NodeIndex chooseColumn() const;
+
+        void cover(NodeIndex column);
+        void uncover(NodeIndex column);
+        // Cover or uncover the columns of every other node in node's option
+        void coverOption(NodeIndex node);
+        void uncoverOption(NodeIndex node);
+
+        void writeSolution(std::size_t depth);
+
+        static constexpr NodeIndex toHeader(std::size_t column) {
+            return static_cast<NodeIndex>(ROOT + 1 + column);
+        }
+    };
+}
@@ -1,68 +1,274 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <memory>
-#include <stack>
-#include <tuple>
-#include <unordered_map>
+#include <span>
 #include <vector>
 
 #include "../utils.h"
 #include "backtrack.h"
 
 SUDOKU_NAMESPACE {
-    class ForwardHeuristic final : public BacktrackHeuristic {
+    // Empty cells grouped by domain size, so the minimum-remaining-values
+    // cell can be found without scanning the board. Within a bucket the
+    // lowest offset wins, which keeps the row-major tie-breaking of a scan.
+    class DomainSizeBuckets {
     private:
-        using DomainDelta = std::pair<BoardPosition, BoardCellDomain>;
-        using DomainDeltas = utils::ArrayVector<DomainDelta>;
+        static constexpr std::size_t CELL_COUNT = BOARD_SIZE * BOARD_SIZE;
+        static constexpr std::size_t WORD_BITS = 64;
+        static constexpr std::size_t WORD_COUNT =
+            (CELL_COUNT + WORD_BITS - 1) / WORD_BITS;
 
-        struct RefinedDomains {
-            DomainDeltas new_domains;
+        using CellSet = std::array<std::uint64_t, WORD_COUNT>;
+
+        std::array<CellSet, BOARD_SIZE + 1> buckets = {};
+        std::array<std::uint8_t, BOARD_SIZE + 1> counts = {};
+        // Bit n is set while bucket n has any cells
+        std::uint16_t non_empty = 0;
+
+    public:
+        void insert(std::size_t offset, BoardCell size) {
+            this->buckets[size][offset / WORD_BITS] |=
+                std::uint64_t(1) << (offset % WORD_BITS);
+            this->counts[size]++;
+            this->non_empty |= std::uint16_t(1u << size);
+        }
+
+        void erase(std::size_t offset, BoardCell size) {
+            this->buckets[size][offset / WORD_BITS] &=
+                ~(std::uint64_t(1) << (offset % WORD_BITS));
+            if (--this->counts[size] == 0) {
+                this->non_empty &= std::uint16_t(~(1u << size));
+            }
+        }
+
+        void move(std::size_t offset, BoardCell old_size, BoardCell new_size) {
+            if (old_size != new_size) {
+                this->erase(offset, old_size);
+                this->insert(offset, new_size);
+            }
+        }
+
+        void clear() {
+            this->buckets = {};
+            this->counts = {};
+            this->non_empty = 0;
+        }
+
+        // Domain size of the smallest non-empty bucket, only meaningful
+        // while there are cells left
+        [[nodiscard]]
+        std::size_t getMinSize() const {
+            return std::size_t(std::countr_zero(this->non_empty));
+        }
+
+        // Number of cells in the smallest non-empty bucket
+        [[nodiscard]]
+        std::size_t getMinCount() const {
+            if (this->non_empty == 0) {
+                return 0;
+            }
+            return this->counts[std::countr_zero(this->non_empty)];
+        }
+
+        // Offset of the first cell past the skipped ones in the smallest
+        // non-empty bucket, or CELL_COUNT if there are no cells left
+        [[nodiscard]]
+        std::size_t findMin(std::size_t skip = 0) const {
+            if (this->non_empty == 0) {
+                return CELL_COUNT;
+            }
+
+            const CellSet& bucket =
+                this->buckets[std::countr_zero(this->non_empty)];
+            for (std::size_t i = 0; i < WORD_COUNT; i++) {
+                std::uint64_t word = bucket[i];
+
+                const auto word_count = std::size_t(std::popcount(word));
+                if (skip >= word_count) {
+                    skip -= word_count;
+                    continue;
+                }
+
+                for (; skip > 0; skip--) {
+                    word &= word - 1;
+                }
+                return i * WORD_BITS + std::countr_zero(word);
+            }
+
+            return CELL_COUNT;
+        }
+    };
+
+    class ForwardHeuristic : public BacktrackHeuristic {
+    public:
+        enum class ValueOrder {
+            // Values are tried 1-9 and forward checked only when tried
+            NATURAL,
+            // Least-constraining value first, from a full forward check
+            LCV,
+            // Least-constraining value first, estimated by counting the
+            // peers each value would be removed from
+            APPROX_LCV
+        };
+
+        enum class RestartSchedule {
+            NONE,
+            // Cutoffs of 1, 1, 2, 1, 1, 2, 4, ... times the base
+            LUBY,
+            // Cutoffs growing by half every run
+            GEOMETRIC
+        };
+
+        // Search restarts, with ties between cells and between values broken
+        // at random so that every run takes a different path
+        struct RestartPolicy {
+            RestartSchedule schedule = RestartSchedule::NONE;
+            // Steps in the first run
+            std::size_t base_cutoff = 512;
+            std::uint64_t seed = 0;
+        };
+
+    protected:
+        // Old domain of a cell, restored when the trail is rewound
+        struct TrailEntry {
+            BoardPosition pos;
+            BoardCellDomain domain;
+        };
+
+        using Trail = utils::ArrayVector<TrailEntry>;
+
+        // Every entry strictly shrinks a domain, so a single search path can
+        // record at most 9 entries per cell
+        static constexpr std::size_t TRAIL_CAPACITY =
+            BOARD_SIZE * BOARD_SIZE * (CELL_MAX - CELL_MIN + 1);
+
+        BoardState<BoardCellDomain> cell_domains;
+        Trail trail;
+
+    private:
+        struct Refinement {
             BoardOffset values_pruned;
             bool is_legal;
         };
 
-        // using DomainDeltas = std::unordered_map<
-        //     BoardPosition,
-        //     BoardCellDomain,
-        //     BoardPosition::Hasher>;
+        // Only maintained when mrv is enabled, and suspended while trying out
+        // values that get rewound right away
+        DomainSizeBuckets mrv_buckets;
+        bool track_buckets;
+        bool mrv;
+        ValueOrder value_order;
 
-        BoardState<BoardCellDomain> cell_domains;
-        bool mrv, lcv;
+        RestartPolicy restarts;
+        std::size_t run_count = 0;
+        // Cell selection is const, but draws from this when breaking ties
+        mutable utils::Random random;
 
     public:
         ForwardHeuristic(
             Board& board,
             std::size_t step_limit,
             bool mrv,
-            bool lcv
+            ValueOrder value_order,
+            RestartPolicy restarts
         );
-        ~ForwardHeuristic() = default;
+        ~ForwardHeuristic() override = default;
 
-        bool solve() override;
+        void reset() override;
 
     protected:
-        bool expand(const BoardPosition& pos) override;
+        BoardPosition selectCell() const override;
+        CandidateQueue orderValues(const BoardPosition& pos) override;
+        bool applyValue(const BoardPosition& pos, BoardCell value) override;
+        void undoValue(const BoardPosition& pos, std::size_t trail_mark)
+            override;
 
-    private:
-        RefinedDomains forwardCheck(const BoardPosition& pos) const;
+        std::size_t getTrailMark() const override {
+            return this->trail.size();
+        }
+
+        std::size_t getRestartCutoff() override;
+
+        void getTraceDomains(
+            BoardState<BoardCellDomain>& domains
+        ) const override {
+            domains = this->cell_domains;
+        }
 
         BoardCellDomain getValidCageValues(const BoardCage& cage) const;
+        BoardCellDomain getValidDerivedValues(std::size_t index) const;
+
+        void refineDomain(
+            const BoardPosition& pos,
+            const BoardCellDomain& new_domain
+        ) {
+            auto& domain = this->cell_domains[pos];
+            if (domain == new_domain) {
+                return;
+            }
+            this->trail.append({pos, domain});
+            this->traceEvent(
+                TraceEventType::PRUNE,
+                pos,
+                CELL_EMPTY,
+                domain.toMask(),
+                new_domain.toMask()
+            );
+            this->updateBucket(pos, domain, new_domain);
+            domain = new_domain;
+        }
+
+    private:
+        void initDomains();
+
+        Refinement placeValue(const BoardPosition& pos, BoardCell value);
+        void removeValue(const BoardPosition& pos, std::size_t trail_mark);
+
+        Refinement forwardCheck(const BoardPosition& pos);
+
+        CandidateQueue orderValuesByForwardCheck(const BoardPosition& pos);
+        CandidateQueue orderValuesByPeerCount(const BoardPosition& pos) const;
+
         BoardPosition findMrvCell() const;
 
-        void applyDeltas(DomainDeltas&& deltas) {
-            for (auto& [p, domain] : deltas.data()) {
-                this->cell_domains[p] = std::move(domain);
+        bool isRandomized() const {
+            return this->restarts.schedule != RestartSchedule::NONE;
+        }
+
+        // Puts values in random order ahead of a stable sort, so that only
+        // ties end up random
+        template <class T>
+        void shuffleTies(std::span<T> values) const {
+            if (this->isRandomized()) {
+                this->random.shuffle(values);
+            }
+        }
+
+        void rewindTrail(std::size_t mark) {
+            const auto entries = this->trail.data();
+            for (std::size_t i = entries.size(); i > mark; i--) {
+                const TrailEntry& entry = entries[i - 1];
+                auto& domain = this->cell_domains[entry.pos];
+                this->updateBucket(entry.pos, domain, entry.domain);
+                domain = entry.domain;
             }
+            this->trail.truncate(mark);
         }
 
-        DomainDeltas applyDeltasWithBackup(DomainDeltas&& deltas) {
-            DomainDeltas originals(deltas.size());
-            for (auto& [p, new_domain] : deltas.data()) {
-                auto& domain = this->cell_domains[p];
-                originals.append(std::make_pair(p, std::move(domain)));
-                domain = std::move(new_domain);
+        void updateBucket(
+            const BoardPosition& pos,
+            const BoardCellDomain& old_domain,
+            const BoardCellDomain& new_domain
+        ) {
+            // Filled cells are not part of any bucket
+            if (this->track_buckets &&
+                this->board.getValues()[pos] == CELL_EMPTY) {
+                this->mrv_buckets.move(
+                    pos.toOffset(), old_domain.size(), new_domain.size()
+                );
             }
-            return originals;
         }
     };
 }
@@ -1,17 +1,119 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stop_token>
+
 #include "../engine/board.h"
+#include "stats.h"
 
 SUDOKU_NAMESPACE {
+    enum class SearchStatus {
+        // The board holds a solution, the last one found when counting
+        SOLVED,
+        // The whole search space was ruled out, or searched through without
+        // reaching the solution limit
+        UNSATISFIABLE,
+        // Ran out of steps or time
+        BUDGET_EXHAUSTED,
+        // Called off through the stop token
+        CANCELLED
+    };
+
+    // Limits on a single solve
+    struct SearchBudget {
+        using Clock = std::chrono::steady_clock;
+
+        std::size_t step_limit = std::numeric_limits<std::size_t>::max();
+        Clock::time_point deadline = Clock::time_point::max();
+        // Solutions to find before stopping, anything past the first is
+        // only counted
+        std::size_t solution_limit = 1;
+        // Lets another thread call the search off
+        std::stop_token stop_token;
+    };
+
     class Heuristic {
     protected:
+        // Time and cancellation aren't urgent, so they're only polled every
+        // this many steps
+        static constexpr std::size_t BUDGET_POLL_INTERVAL = 256;
+
         Board& board;
 
+        std::size_t step_count = 0;
+        std::size_t solution_count = 0;
+        SearchBudget budget;
+        // Empty unless built with SUDOKU_SEARCH_STATS. Cell selection is
+        // const, but counts its picks in here.
+        [[no_unique_address]] mutable SearchStatsPolicy stats;
+
     public:
-        explicit Heuristic(Board& board) : board(board) {}
+        Heuristic(Board& board, std::size_t step_limit) : board(board) {
+            this->budget.step_limit = step_limit;
+        }
+
+        virtual SearchStatus solve() = 0;
 
-        virtual bool solve() = 0;
+        // Get ready to solve whatever the board holds now, so one instance
+        // can be reused across puzzles
+        virtual void reset() {
+            this->step_count = 0;
+            this->solution_count = 0;
+            this->stats.reset();
+        }
+
+        std::size_t getStepCount() const {
+            return this->step_count;
+        }
+
+        // Solutions found since the last reset(), exact unless the search
+        // stopped at the solution limit
+        std::size_t getSolutionCount() const {
+            return this->solution_count;
+        }
+
+        // All zero unless built with SUDOKU_SEARCH_STATS
+        SearchStats getSearchStats() const {
+            return this->stats.get();
+        }
+
+        const SearchBudget& getBudget() const {
+            return this->budget;
+        }
+
+        void setBudget(SearchBudget budget) {
+            this->budget = std::move(budget);
+        }
 
         virtual ~Heuristic() = default;
+
+    protected:
+        // Called on every solution, returns whether that was the last one
+        // wanted
+        bool recordSolution() {
+            return ++this->solution_count >= this->budget.solution_limit;
+        }
+
+        // Called once per step, returns why the search has to stop, if it
+        // has to
+        std::optional<SearchStatus> checkBudget() const {
+            if (this->step_count > this->budget.step_limit) {
+                return SearchStatus::BUDGET_EXHAUSTED;
+            }
+            if (this->step_count % BUDGET_POLL_INTERVAL != 0) {
+                return std::nullopt;
+            }
+
+            if (this->budget.stop_token.stop_requested()) {
+                return SearchStatus::CANCELLED;
+            }
+            if (SearchBudget::Clock::now() >= this->budget.deadline) {
+                return SearchStatus::BUDGET_EXHAUSTED;
+            }
+            return std::nullopt;
+        }
     };
 }
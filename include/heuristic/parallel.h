@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+
+#include "backtrack.h"
+
+SUDOKU_NAMESPACE {
+    // Subtrees of a search shared between the threads of a parallel search.
+    // Each worker owns a deque of tasks: it takes its own newest tasks
+    // first, and steals the oldest, and so largest, ones from the others.
+    class SearchPool {
+    public:
+        // Steps are added to the shared budget in batches of this many
+        static constexpr std::size_t STEP_BATCH = 64;
+
+        // Subtree reached by placing each assignment of the path in order
+        struct Task {
+            std::array<SearchAssignment, BOARD_SIZE * BOARD_SIZE> path;
+            std::size_t length = 0;
+
+            void append(const SearchAssignment& assignment) {
+                this->path[this->length++] = assignment;
+            }
+
+            std::span<const SearchAssignment> getPath() const {
+                return std::span(this->path).first(this->length);
+            }
+        };
+
+    private:
+        struct alignas(64) Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::unique_ptr<Queue[]> queues;
+        std::size_t worker_count;
+        std::size_t step_limit;
+        std::size_t solution_limit;
+
+        // Tasks queued or being searched, the tree is exhausted at zero
+        std::atomic<std::size_t> pending_tasks = 0;
+        std::atomic<std::size_t> queued_tasks = 0;
+        std::atomic<std::size_t> idle_workers = 0;
+        std::atomic<std::size_t> step_count = 0;
+        std::atomic<std::size_t> solution_count = 0;
+        // Bumped whenever idle workers should look for work again
+        std::atomic<std::uint32_t> version = 0;
+        // Stops every worker, through the stop token of its budget
+        std::stop_source stop_source;
+        std::atomic<bool> over_budget = false;
+
+    public:
+        SearchPool(
+            std::size_t worker_count,
+            std::size_t step_limit,
+            std::size_t solution_limit
+        );
+
+        void push(std::size_t worker, const Task& task);
+
+        // Waits for a task, returns false once the search is over
+        bool take(std::size_t worker, Task& task);
+
+        // Called after searching a taken task without finding a solution
+        void finishTask();
+
+        void stop();
+
+        // Same as stop(), but the search ends as out of budget
+        void exhaustBudget();
+
+        std::stop_token getStopToken() const {
+            return this->stop_source.get_token();
+        }
+
+        // Returns false once the shared step budget runs out
+        bool addSteps(std::size_t steps);
+
+        // Returns true once the workers found as many solutions as wanted
+        bool addSolution() {
+            return ++this->solution_count >= this->solution_limit;
+        }
+
+        // Whether a worker is waiting with nothing left to steal
+        bool isHungry() const {
+            return this->idle_workers.load(std::memory_order_relaxed) > 0 &&
+                   this->queued_tasks.load(std::memory_order_relaxed) == 0;
+        }
+
+        bool isOverBudget() const {
+            return this->over_budget.load();
+        }
+
+    private:
+        bool tryTake(std::size_t worker, Task& task);
+        void wakeWorkers();
+    };
+
+    // Runs one backtracking heuristic per thread, each on its own copy of
+    // the board, splitting the search tree between them through a
+    // SearchPool. The budget is shared by all of them.
+    class ParallelHeuristic final : public Heuristic {
+    public:
+        using Factory =
+            std::function<std::unique_ptr<BacktrackHeuristic>(Board& board)>;
+
+    private:
+        std::size_t thread_count;
+        Factory factory;
+
+    public:
+        ParallelHeuristic(
+            Board& board,
+            std::size_t step_limit,
+            std::size_t thread_count,
+            Factory factory
+        );
+
+        SearchStatus solve() override;
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "heuristic.h"
+
+SUDOKU_NAMESPACE {
+    // Races several heuristics on their own copies of the board, one thread
+    // each. The first one to finish wins and the others are cancelled
+    // through a shared stop token. Members keep their own step limits, but
+    // share the deadline and stop token of the portfolio.
+    class PortfolioHeuristic final : public Heuristic {
+    public:
+        using Factory = std::function<std::unique_ptr<Heuristic>(Board& board)>;
+
+        struct Member {
+            std::string name;
+            Factory factory;
+        };
+
+    private:
+        std::vector<Member> members;
+        // Index of the member that finished first, or members.size()
+        std::size_t winner;
+
+    public:
+        PortfolioHeuristic(
+            Board& board,
+            std::size_t step_limit,
+            std::vector<Member> members
+        );
+
+        SearchStatus solve() override;
+
+        // Name of the member that won the last race, empty if none finished
+        std::string_view getWinner() const;
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <span>
+
+#include "forward.h"
+
+SUDOKU_NAMESPACE {
+    // Forward checking followed by propagation to a fixpoint after every
+    // assignment: naked singles, hidden singles in rows, columns, boxes and
+    // cages, and bound tightening on cage and derived sums. Cells are always
+    // picked by MRV, so cells that propagation narrows down to one value
+    // never branch.
+    class PropagationHeuristic final : public ForwardHeuristic {
+    private:
+        // Rows, columns and boxes come first, followed by one unit per cage
+        // and one per derived sum
+        static constexpr std::size_t HOUSE_COUNT = 3 * BOARD_SIZE;
+        static constexpr std::size_t DERIVED_UNIT_START =
+            HOUSE_COUNT + BOARD_SIZE * BOARD_SIZE;
+        static constexpr std::size_t MAX_UNIT_COUNT =
+            DERIVED_UNIT_START + Board::MAX_DERIVED_SUMS;
+
+        // Units waiting to be checked. Changed cells are picked up straight
+        // from the trail, which already lists them in order.
+        std::array<std::uint16_t, MAX_UNIT_COUNT> unit_queue;
+        std::size_t unit_queue_size = 0;
+        std::bitset<MAX_UNIT_COUNT> is_queued;
+
+    public:
+        PropagationHeuristic(
+            Board& board,
+            std::size_t step_limit,
+            ValueOrder value_order,
+            RestartPolicy restarts
+        );
+
+    protected:
+        bool applyValue(const BoardPosition& pos, BoardCell value) override;
+
+    private:
+        bool propagate(std::size_t trail_mark);
+
+        void queueUnit(std::size_t unit);
+        void queueUnits(const BoardPosition& pos);
+
+        bool eliminateSingle(const BoardPosition& pos, BoardCell value);
+        bool checkHouse(const Board::LineOrBox& cells);
+        bool tightenSum(
+            std::span<const BoardPosition> sum_cells,
+            unsigned target,
+            const Board::CageState& state,
+            bool distinct
+        );
+
+        bool narrowDomain(const BoardPosition& pos, BoardCellMask mask) {
+            const auto domain = this->cell_domains[pos].toMask();
+            const auto narrowed = static_cast<BoardCellMask>(domain & mask);
+            if (narrowed != domain) {
+                this->refineDomain(pos, BoardCellDomain::fromMask(narrowed));
+            }
+            return narrowed != 0;
+        }
+    };
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#include "../engine/board.h"
+
+// Build with SUDOKU_SEARCH_STATS=1 to count what the searches do. Off by
+// default, since the counting and timing shows in the solve times.
+#ifndef SUDOKU_SEARCH_STATS
+#define SUDOKU_SEARCH_STATS 0
+#endif
+
+SUDOKU_NAMESPACE {
+    // Parts of a backtracking step that search time is split between
+    enum class SearchPhase {
+        // Picking the next cell to branch on
+        SELECT,
+        // Picking the order to try its values in, which includes the trial
+        // forward checks of LCV
+        ORDER,
+        // Placing a value and everything it implies, and taking it back
+        PROPAGATE
+    };
+
+    inline constexpr std::size_t SEARCH_PHASE_COUNT = 3;
+
+    struct SearchStats {
+        // Values placed by the search
+        std::size_t nodes = 0;
+        // Cells that ran out of values to try, returning to the cell before
+        std::size_t backtracks = 0;
+        std::size_t forward_checks = 0;
+        // Forward checks that emptied some domain
+        std::size_t failed_forward_checks = 0;
+        std::size_t values_pruned = 0;
+        std::size_t max_depth = 0;
+        // Domain sizes of the cells picked by minimum remaining values
+        std::array<std::size_t, BOARD_SIZE + 1> mrv_histogram = {};
+        // Seconds spent in each SearchPhase
+        std::array<double, SEARCH_PHASE_COUNT> phase_seconds = {};
+
+        void merge(const SearchStats& other) {
+            this->nodes += other.nodes;
+            this->backtracks += other.backtracks;
+            this->forward_checks += other.forward_checks;
+            this->failed_forward_checks += other.failed_forward_checks;
+            this->values_pruned += other.values_pruned;
+            this->max_depth = std::max(this->max_depth, other.max_depth);
+            for (std::size_t i = 0; i < this->mrv_histogram.size(); i++) {
+                this->mrv_histogram[i] += other.mrv_histogram[i];
+            }
+            for (std::size_t i = 0; i < SEARCH_PHASE_COUNT; i++) {
+                this->phase_seconds[i] += other.phase_seconds[i];
+            }
+        }
+    };
+
+    // Records SearchStats for the searches, which call it whether it's
+    // enabled or not. Disabled, every call is empty and compiles away.
+    template <bool Enabled>
+    class SearchStatsRecorder {
+    public:
+        static constexpr bool ENABLED = false;
+
+        void recordNode(std::size_t /* depth */) {}
+        void recordBacktrack() {}
+        void recordForwardCheck(
+            bool /* is_legal */,
+            std::size_t /* values_pruned */
+        ) {}
+        void recordMrvPick(std::size_t /* domain_size */) {}
+
+        // Calls f, adding the time it took to the phase
+        template <class F>
+        decltype(auto) measure(SearchPhase /* phase */, F&& f) {
+            return f();
+        }
+
+        void merge(const SearchStats& /* other */) {}
+        void reset() {}
+
+        SearchStats get() const {
+            return {};
+        }
+    };
+
+    template <>
+    class SearchStatsRecorder<true> {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        SearchStats stats;
+
+    public:
+        static constexpr bool ENABLED = true;
+
+        void recordNode(std::size_t depth) {
+            this->stats.nodes++;
+            this->stats.max_depth = std::max(this->stats.max_depth, depth);
+        }
+
+        void recordBacktrack() {
+            this->stats.backtracks++;
+        }
+
+        void recordForwardCheck(bool is_legal, std::size_t values_pruned) {
+            this->stats.forward_checks++;
+            this->stats.failed_forward_checks += !is_legal;
+            this->stats.values_pruned += values_pruned;
+        }
+
+        void recordMrvPick(std::size_t domain_size) {
+            this->stats.mrv_histogram[domain_size]++;
+        }
+
+        template <class F>
+        decltype(auto) measure(SearchPhase phase, F&& f) {
+            struct Timer {
+                double& seconds;
+                Clock::time_point start = Clock::now();
+
+                ~Timer() {
+                    const auto elapsed = Clock::now() - this->start;
+                    this->seconds +=
+                        std::chrono::duration<double>(elapsed).count();
+                }
+            } timer{this->stats.phase_seconds[std::size_t(phase)]};
+
+            return f();
+        }
+
+        void merge(const SearchStats& other) {
+            this->stats.merge(other);
+        }
+
+        void reset() {
+            this->stats = {};
+        }
+
+        SearchStats get() const {
+            return this->stats;
+        }
+    };
+
+    using SearchStatsPolicy = SearchStatsRecorder<SUDOKU_SEARCH_STATS != 0>;
+}
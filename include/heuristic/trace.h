@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include "../engine/board.h"
+
+SUDOKU_NAMESPACE {
+    enum class TraceEventType : std::uint8_t {
+        // A value placed in a cell
+        ASSIGN,
+        // The value last placed in the cell taken back, along with every
+        // domain pruned since
+        UNASSIGN,
+        // A cell's domain narrowed
+        PRUNE,
+        // A cell ran out of values to try, returning to the cell before
+        BACKTRACK,
+        // Cell picked to branch on next by minimum remaining values
+        MRV_PICK
+    };
+
+    struct TraceEvent {
+        TraceEventType type;
+        // Offset of the cell
+        std::uint8_t cell;
+        // Value assigned, or domain size of the cell picked
+        BoardCell value;
+        std::uint8_t reserved;
+        // Domain before and after a prune, as masks
+        BoardCellMask old_domain;
+        BoardCellMask new_domain;
+    };
+
+    static_assert(sizeof(TraceEvent) == 8);
+
+    // Events of one solve in order, and the board they started from
+    struct SearchTrace {
+        BoardState<BoardCell> initial_values =
+            BoardState<BoardCell>(BOARD_SIZE, CELL_EMPTY);
+        BoardState<BoardCellDomain> initial_domains =
+            BoardState<BoardCellDomain>(BOARD_SIZE, ~BoardCellDomain());
+        std::vector<TraceEvent> events;
+        // Events overwritten before the trace was taken, the initial state
+        // no longer leads to the first event if there were any
+        std::uint64_t dropped_count = 0;
+
+        void save(std::ostream& output) const;
+        static SearchTrace load(std::istream& input);
+
+        // Writes the events as Chrome trace-event JSON, for chrome://tracing
+        // or Perfetto. Assignments nest as slices, everything else is an
+        // instant, and timestamps count events rather than time.
+        void writeChromeTrace(std::ostream& output) const;
+    };
+
+    // Records the events of a search into a ring allocated up front, so
+    // recording never allocates. Once full, the oldest events are
+    // overwritten.
+    class TraceRecorder {
+    private:
+        std::unique_ptr<TraceEvent[]> events;
+        // A power of two, so positions wrap with a mask
+        std::size_t capacity;
+        // Recorded since begin(), including overwritten ones
+        std::uint64_t recorded_count = 0;
+
+        BoardState<BoardCell> initial_values;
+        BoardState<BoardCellDomain> initial_domains;
+
+    public:
+        // Capacity is rounded up to a power of two
+        explicit TraceRecorder(std::size_t capacity);
+
+        // Starts a new trace from the given board and domains
+        void begin(
+            const BoardState<BoardCell>& values,
+            const BoardState<BoardCellDomain>& domains
+        );
+
+        void record(const TraceEvent& event) {
+            this->events[this->recorded_count++ & (this->capacity - 1)] =
+                event;
+        }
+
+        // Copies out the events still held, oldest first
+        SearchTrace getTrace() const;
+    };
+
+    // Rebuilds the board and domains of a traced search at any event. The
+    // prunes are kept on a trail of their own, which unassignments rewind
+    // the same way the search rewound its own.
+    class TraceReplayer {
+    private:
+        struct Assignment {
+            BoardPosition pos;
+            std::size_t prune_mark;
+        };
+
+        struct Prune {
+            BoardPosition pos;
+            BoardCellDomain domain;
+        };
+
+        const SearchTrace& trace;
+        BoardState<BoardCell> values;
+        BoardState<BoardCellDomain> domains;
+        std::vector<Assignment> assignments;
+        std::vector<Prune> prunes;
+        // Events applied so far
+        std::size_t position = 0;
+
+    public:
+        // Throws if the trace dropped events, since the initial state then
+        // no longer leads to the events that are left
+        explicit TraceReplayer(const SearchTrace& trace);
+
+        // Applies the next event, throws if it doesn't fit the state so far
+        void step();
+
+        // Replays up to just before the given event, or the end
+        void seek(std::size_t position);
+
+        std::size_t getPosition() const {
+            return this->position;
+        }
+
+        bool isDone() const {
+            return this->position == this->trace.events.size();
+        }
+
+        // Assignments in effect
+        std::size_t getDepth() const {
+            return this->assignments.size();
+        }
+
+        const BoardState<BoardCell>& getValues() const {
+            return this->values;
+        }
+
+        const BoardState<BoardCellDomain>& getDomains() const {
+            return this->domains;
+        }
+
+    private:
+        void restart();
+    };
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "base.h"
+
+SUDOKU_NAMESPACE {
+    enum class PerfCounter {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        // Level 1 data cache read misses
+        L1D_MISSES,
+        // Last level cache misses
+        LLC_MISSES
+    };
+
+    inline constexpr std::size_t PERF_COUNTER_COUNT = 5;
+
+    // Name of the counter in data files and summaries
+    std::string_view getPerfCounterName(PerfCounter counter);
+
+    // Counts over one stretch of code, for each PerfCounter that could be
+    // opened. Counts the kernel had to multiplex are scaled up to the whole
+    // stretch.
+    struct PerfSample {
+        std::array<std::optional<std::uint64_t>, PERF_COUNTER_COUNT> counts;
+
+        const std::optional<std::uint64_t>& operator[](
+            PerfCounter counter
+        ) const {
+            return this->counts[std::size_t(counter)];
+        }
+    };
+
+    // Hardware counters of the thread that opened them, and of threads it
+    // starts while counting. Only on Linux, through perf_event_open, and
+    // only where the kernel allows it, which containers and VMs often
+    // don't. Counters that can't be opened stay empty in every sample.
+    class PerfCounters {
+    private:
+        std::array<int, PERF_COUNTER_COUNT> fds;
+        // Why the first counter that failed to open did
+        std::string error;
+
+    public:
+        PerfCounters();
+        PerfCounters(const PerfCounters&) = delete;
+        ~PerfCounters();
+
+        // Whether any counter could be opened
+        bool isAvailable() const;
+
+        const std::string& getError() const {
+            return this->error;
+        }
+
+        // Zeroes the counters and starts counting
+        void start();
+
+        // Stops counting and reads the counters
+        PerfSample stop();
+    };
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "engine/board.h"
+
+SUDOKU_NAMESPACE {
+    // Puzzle decoded ahead of the solver that takes it
+    struct PrefetchedPuzzle {
+        // Position in the order the source gave it
+        std::size_t index = 0;
+        std::vector<BoardCage> cages;
+        BoardState<BoardCell> solution =
+            BoardState<BoardCell>(BOARD_SIZE, CELL_EMPTY);
+    };
+
+    // How full the ring was, to tell whether a run waits on its input or on
+    // its solvers
+    struct PrefetchStats {
+        std::size_t depth = 0;
+        std::size_t taken = 0;
+        // Sum of the puzzles ready whenever one was taken
+        std::size_t ready_total = 0;
+        // Solvers found nothing ready, the run is waiting on input
+        std::size_t solver_stalls = 0;
+        // The reader found the ring full, the run is waiting on solvers
+        std::size_t reader_stalls = 0;
+    };
+
+    // Decodes puzzles on a thread of its own into a bounded ring, which any
+    // number of solver threads take them from. The ring holds no locks:
+    // solvers claim positions below the head by moving the tail, and hand
+    // each slot back to the reader through its sequence number. Slots keep
+    // their storage, and taking a puzzle swaps it with the taker's, so
+    // nothing allocates once every cage has been seen.
+    class PuzzlePrefetcher {
+    public:
+        // Fills in the next puzzle, returns false once there are no more
+        using Source = std::function<
+            bool(std::vector<BoardCage>& cages, BoardState<BoardCell>& solution)
+        >;
+
+    private:
+        struct alignas(64) Slot {
+            // Position the slot is free to be filled for, whether it has
+            // been is told by the head
+            std::atomic<std::size_t> sequence;
+            PrefetchedPuzzle puzzle;
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        std::size_t depth;
+        Source source;
+
+        // Positions filled and taken so far, apart so they don't share a
+        // cache line
+        alignas(64) std::atomic<std::size_t> head = 0;
+        alignas(64) std::atomic<std::size_t> tail = 0;
+        // Bumped whenever a puzzle is filled or the source runs out, and
+        // whenever a slot is handed back, to wake whoever waits on it
+        std::atomic<std::uint32_t> filled_version = 0;
+        std::atomic<std::uint32_t> freed_version = 0;
+        std::atomic<bool> is_done = false;
+        std::atomic<bool> is_stopped = false;
+        // Thrown by the source, rethrown by finish()
+        std::exception_ptr error;
+
+        std::atomic<std::size_t> ready_total = 0;
+        std::atomic<std::size_t> solver_stalls = 0;
+        std::size_t reader_stalls = 0;
+
+        // Last, so it stops before the rest is destroyed
+        std::jthread reader;
+
+    public:
+        PuzzlePrefetcher(std::size_t depth, Source source);
+        PuzzlePrefetcher(const PuzzlePrefetcher&) = delete;
+        ~PuzzlePrefetcher();
+
+        // Swaps the next puzzle into the given one, waiting for it if need
+        // be. Returns false once there are no more, or after stop().
+        bool take(PrefetchedPuzzle& puzzle);
+
+        // Stops reading ahead, puzzles not yet taken are dropped
+        void stop();
+
+        // Waits for the reader, and rethrows whatever the source threw
+        void finish();
+
+        // Only complete after finish()
+        PrefetchStats getStats() const;
+
+    private:
+        void readPuzzles();
+    };
+}
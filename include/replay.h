@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <string>
+
+#include "base.h"
+
+SUDOKU_NAMESPACE {
+    // Prints what the trace in the file holds, then the board and domains
+    // before the given event, or at the end, and exports it for a timeline
+    // viewer if asked. Returns the exit code, 1 if the trace lost events
+    // and there was nothing to export instead.
+    int replayTrace(
+        const std::string& filename,
+        std::optional<std::size_t> step,
+        const std::optional<std::string>& chrome_filename,
+        std::ostream& output
+    );
+}
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <array>
+#include <condition_variable>
+#include <cstdint>
 #include <iosfwd>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "engine/board.h"
@@ -13,8 +20,65 @@ SUDOKU_NAMESPACE::serialization {
         BoardState<BoardCell> solution;
     };
 
+    // Layout of KSF2 bundles. The header is followed by one section per
+    // field, each holding a fixed-size record for every puzzle in order, so
+    // finding a puzzle takes no index and a batch is one contiguous slice
+    // of each section. Sections start on ALIGNMENT byte boundaries.
+    struct Ksf2Layout {
+        // 'KSF2' little endian
+        static constexpr uint32_t MAGIC = 0x3246534B;
+        static constexpr uint8_t VERSION = 2;
+        // 4 magic + 1 version + 1 compression + 2 pad + 4 count + 4 section
+        // count + 8 per section offset, padded to the alignment
+        static constexpr size_t HEADER_SIZE = 128;
+        static constexpr size_t ALIGNMENT = 64;
+        // Every cell a cage of its own
+        static constexpr size_t MAX_CAGES = BOARD_SIZE * BOARD_SIZE;
+
+        // Only uncompressed sections are written so far, readers reject
+        // anything else
+        enum class Compression : uint8_t {
+            NONE = 0
+        };
+
+        enum Section : size_t {
+            // 81 bytes, row-major 1..9
+            SOLUTIONS,
+            CAGE_COUNTS,
+            // One byte per cage, MAX_CAGES per puzzle
+            CAGE_SUMS,
+            CAGE_SIZES,
+            // Cells of every cage in cage order, one (row << 4 | col) byte
+            // each
+            CAGE_CELLS,
+            SECTION_COUNT
+        };
+
+        static constexpr std::array<size_t, SECTION_COUNT> RECORD_SIZES = {
+            BOARD_SIZE * BOARD_SIZE,
+            1,
+            MAX_CAGES,
+            MAX_CAGES,
+            BOARD_SIZE * BOARD_SIZE
+        };
+
+        // Where each section starts in a bundle of puzzle_count puzzles
+        static std::array<uint64_t, SECTION_COUNT> section_offsets(
+            uint32_t puzzle_count
+        );
+    };
+
+    enum class BundleFormat {
+        KSF1,
+        KSF2,
+        // One puzzle per line: the 81 solution digits, then a "sum:cells"
+        // word per cage with two digits, row and column, per cell, e.g.
+        // "12:00,01,10". Written and read front to back, so it streams.
+        TEXT
+    };
+
     class PuzzleLoader {
-    private:
+    public:
         static constexpr size_t SOLUTION_SIZE = BOARD_SIZE * BOARD_SIZE;
         // 4 magic + 1 version + 3 pad + 4 count
         static constexpr size_t HEADER_SIZE = 12;
@@ -22,8 +86,14 @@ SUDOKU_NAMESPACE::serialization {
         static constexpr uint32_t MAGIC = 0x3146534B;
         static constexpr uint8_t VERSION = 1;
 
+    private:
         std::istream& file;
+        BundleFormat format = BundleFormat::KSF1;
+        uint32_t count = 0;
+        // KSF1 only
         utils::ArrayVector<size_t> index_offsets;
+        // KSF2 only
+        std::array<uint64_t, Ksf2Layout::SECTION_COUNT> section_offsets{};
 
     public:
         PuzzleLoader(std::istream& file);
@@ -31,7 +101,11 @@ SUDOKU_NAMESPACE::serialization {
         ~PuzzleLoader() = default;
 
         std::uint32_t puzzle_count() const {
-            return static_cast<std::uint32_t>(this->index_offsets.size());
+            return this->count;
+        }
+
+        BundleFormat bundle_format() const {
+            return this->format;
         }
 
         std::unique_ptr<Puzzle> load_puzzle(size_t index);
@@ -39,5 +113,282 @@ SUDOKU_NAMESPACE::serialization {
     private:
         void read_header();
         void read_index();
+
+        std::unique_ptr<Puzzle> load_ksf2_puzzle(size_t index);
+    };
+
+    // Cage of a mapped puzzle, its cells are decoded as they're read
+    class CageView {
+    private:
+        unsigned cage_sum;
+        std::size_t cage_size;
+        // One (row << 4 | col) byte per cell
+        const uint8_t* cells;
+
+    public:
+        CageView(unsigned sum, std::size_t size, const uint8_t* cells)
+            : cage_sum(sum), cage_size(size), cells(cells) {}
+
+        unsigned sum() const {
+            return this->cage_sum;
+        }
+
+        std::size_t size() const {
+            return this->cage_size;
+        }
+
+        BoardPosition cell(std::size_t index) const {
+            const uint8_t pair = this->cells[index];
+            return {BoardOffset(pair >> 4), BoardOffset(pair & 0x0F)};
+        }
+    };
+
+    // Puzzle read in place from a mapped bundle, valid as long as the
+    // loader is. Checked when created, so reading it never fails.
+    class PuzzleView {
+    public:
+        class CageIterator {
+        private:
+            const uint8_t* cells;
+            // KSF1 puts the sum and size of a cage in front of its cells,
+            // these are only set for KSF2, which keeps them apart
+            const uint8_t* sums;
+            const uint8_t* sizes;
+
+        public:
+            CageIterator(
+                const uint8_t* cells,
+                const uint8_t* sums = nullptr,
+                const uint8_t* sizes = nullptr
+            )
+                : cells(cells), sums(sums), sizes(sizes) {}
+
+            CageView operator*() const {
+                if (this->sums == nullptr) {
+                    return CageView(
+                        this->cells[0], this->cells[1], this->cells + 2
+                    );
+                }
+                return CageView(*this->sums, *this->sizes, this->cells);
+            }
+
+            CageIterator& operator++() {
+                if (this->sums == nullptr) {
+                    this->cells += 2 + this->cells[1];
+                } else {
+                    this->cells += *this->sizes;
+                    ++this->sums;
+                    ++this->sizes;
+                }
+                return *this;
+            }
+
+            bool operator==(const CageIterator& other) const {
+                return this->cells == other.cells;
+            }
+        };
+
+    private:
+        const uint8_t* solution_data;
+        std::size_t cage_total;
+        CageIterator first_cage;
+        const uint8_t* cages_end;
+
+    public:
+        PuzzleView(
+            const uint8_t* solution,
+            std::size_t cage_count,
+            CageIterator first_cage,
+            const uint8_t* cages_end
+        )
+            : solution_data(solution), cage_total(cage_count),
+              first_cage(first_cage), cages_end(cages_end) {}
+
+        // 81 bytes, row-major 1..9
+        std::span<const uint8_t> solution() const {
+            return std::span(this->solution_data, PuzzleLoader::SOLUTION_SIZE);
+        }
+
+        std::size_t cage_count() const {
+            return this->cage_total;
+        }
+
+        CageIterator begin() const {
+            return this->first_cage;
+        }
+
+        CageIterator end() const {
+            return CageIterator(this->cages_end);
+        }
+
+        // Decodes the cages into storage reused from earlier puzzles, which
+        // only allocates when a cage outgrows what was there before
+        void decode_cages(std::vector<BoardCage>& cages) const;
+
+        void decode_solution(BoardState<BoardCell>& solution) const;
+
+        // View of a KSF1 payload, everything after its length. Throws if
+        // the cages run past the end.
+        static PuzzleView from_ksf1_payload(std::span<const uint8_t> payload);
+    };
+
+    // Reads bundles of either format straight out of a memory mapping of
+    // the whole file, or out of a copy of it where mapping isn't available.
+    // Views are only read from, so any number of threads can share one
+    // loader.
+    class MappedPuzzleLoader {
+    private:
+        std::span<const uint8_t> bytes;
+        // Only used without a mapping
+        std::vector<uint8_t> buffer;
+        void* mapping = nullptr;
+
+        BundleFormat format = BundleFormat::KSF1;
+        uint32_t count = 0;
+        // KSF1 only
+        std::span<const uint8_t> index;
+        // KSF2 only
+        std::array<std::span<const uint8_t>, Ksf2Layout::SECTION_COUNT>
+            sections;
+
+    public:
+        explicit MappedPuzzleLoader(const std::string& filename);
+        MappedPuzzleLoader(const MappedPuzzleLoader&) = delete;
+        ~MappedPuzzleLoader();
+
+        std::uint32_t puzzle_count() const {
+            return this->count;
+        }
+
+        BundleFormat bundle_format() const {
+            return this->format;
+        }
+
+        PuzzleView view_puzzle(size_t index) const;
+
+    private:
+        void read_header();
+        void read_ksf2_header();
+        PuzzleView view_ksf2_puzzle(size_t index) const;
+        void unmap();
+    };
+
+    // Reads puzzles front to back from a stream that can't seek, such as a
+    // pipe: KSF1 bundles, whose puzzles come after the index in order, or
+    // TEXT. A thread reads what has arrived of the stream into one chunk
+    // while the other is parsed, and memory use doesn't grow with the
+    // stream.
+    class PuzzleStreamReader {
+    public:
+        // At most, a chunk holds what was there to read
+        static constexpr size_t CHUNK_SIZE = 64 * 1024;
+        // Far above what 81 cells can take, it only bounds bad input
+        static constexpr uint32_t MAX_PAYLOAD_SIZE = 4096;
+
+    private:
+        struct Chunk {
+            std::vector<char> data;
+            size_t size = 0;
+            // Read in and not yet parsed
+            bool is_full = false;
+        };
+
+        std::istream& file;
+        BundleFormat format = BundleFormat::TEXT;
+        // KSF1 only
+        uint32_t remaining = 0;
+        // Text line number, for errors
+        size_t line_number = 0;
+
+        std::array<Chunk, 2> chunks;
+        std::mutex chunk_mutex;
+        std::condition_variable_any chunk_ready;
+        // The reader thread is done, it hit the end or an error
+        bool read_failed = false;
+
+        // Chunk being parsed, and what's left of it
+        size_t current = 0;
+        bool holds_chunk = false;
+        std::span<const char> unread;
+        bool at_end = false;
+
+        // Reused across puzzles
+        std::vector<uint8_t> payload;
+        std::string line;
+
+        // Last, so it stops before the rest is destroyed
+        std::jthread reader;
+
+    public:
+        // Starts reading right away, the format is told by the first bytes
+        explicit PuzzleStreamReader(std::istream& file);
+        PuzzleStreamReader(const PuzzleStreamReader&) = delete;
+        ~PuzzleStreamReader() = default;
+
+        BundleFormat bundle_format() const {
+            return this->format;
+        }
+
+        // Decodes the next puzzle into storage reused from earlier ones,
+        // returns false once there are no more
+        bool read_puzzle(
+            std::vector<BoardCage>& cages,
+            BoardState<BoardCell>& solution
+        );
+
+    private:
+        void read_chunks(std::stop_token stop_token);
+
+        // Moves on to the next chunk, returns false at the end
+        bool next_chunk();
+        bool read_bytes(uint8_t* out, size_t size);
+        bool skip_bytes(uint64_t size);
+        // Without the line break, returns false at the end
+        bool read_line(std::string& out);
+
+        bool read_ksf1_puzzle(
+            std::vector<BoardCage>& cages,
+            BoardState<BoardCell>& solution
+        );
+        bool read_text_puzzle(
+            std::vector<BoardCage>& cages,
+            BoardState<BoardCell>& solution
+        );
+    };
+
+    // Writes bundles that either loader reads back. KSF1 is written the
+    // same way data/killer_pack.py does: header and a placeholder index
+    // first, then the puzzles, then the real index. KSF2 sections are
+    // filled in memory and written out at the end. TEXT goes straight out.
+    class PuzzleWriter {
+    private:
+        std::ostream& file;
+        BundleFormat format;
+        uint32_t expected_count;
+        uint32_t saved_count = 0;
+        // KSF1 only
+        std::vector<uint64_t> index_offsets;
+        // KSF2 only
+        std::array<std::vector<uint8_t>, Ksf2Layout::SECTION_COUNT> sections;
+
+    public:
+        // The file has to be seekable for KSF1, its index is filled in last
+        PuzzleWriter(
+            std::ostream& file,
+            std::uint32_t puzzle_count,
+            BundleFormat format = BundleFormat::KSF1
+        );
+        PuzzleWriter(const PuzzleWriter&) = delete;
+        ~PuzzleWriter() = default;
+
+        void save_puzzle(const Puzzle& puzzle);
+
+        // Writes the index or the sections, once every puzzle is saved
+        void finish();
+
+    private:
+        void save_ksf1_puzzle(const Puzzle& puzzle);
+        void save_ksf2_puzzle(const Puzzle& puzzle);
+        void save_text_puzzle(const Puzzle& puzzle);
     };
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <ctime>
 #include <functional>
 #include <memory>
 #include <span>
@@ -8,6 +11,32 @@
 #include "base.h"
 
 SUDOKU_NAMESPACE::utils {
+    enum class Timer {
+        // CPU time of the calling thread, which excludes other puzzles
+        // solved alongside it
+        THREAD_CPU,
+        // Parallel searches span several threads, so they're timed by the
+        // clock
+        WALL_CLOCK
+    };
+
+    // Seconds from some fixed point, only differences between them mean
+    // anything
+    inline double getSeconds(Timer timer) {
+        if (timer == Timer::THREAD_CPU) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+            timespec now;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+            return now.tv_sec + now.tv_nsec / 1e9;
+#else
+            return std::clock() / static_cast<double>(CLOCKS_PER_SEC);
+#endif
+        }
+
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration<double>(now).count();
+    }
+
     template <class T>
     inline void combineHash(std::size_t& seed, const T& v) {
         // Taken from the old implementation used by Boost...
@@ -90,11 +119,18 @@ SUDOKU_NAMESPACE::utils {
         }
 
         void clear() noexcept {
-            for (std::size_t i = 0; i < this->m_size; i++) {
+            this->truncate(0);
+        }
+
+        // Destroys every element past new_size
+        void truncate(std::size_t new_size) noexcept {
+            for (std::size_t i = new_size; i < this->m_size; i++) {
                 std::destroy_at(&this->buffer()[i]);
             }
 
-            this->m_size = 0;
+            if (new_size < this->m_size) {
+                this->m_size = new_size;
+            }
         }
 
         ~ArrayVector() noexcept {
@@ -120,4 +156,34 @@ SUDOKU_NAMESPACE::utils {
             return std::launder(reinterpret_cast<T*>(this->m_buffer.get()));
         }
     };
+
+    // SplitMix64, small and fast, and unlike the standard distributions it
+    // gives the same sequence for a seed on every platform
+    class Random {
+    private:
+        std::uint64_t state;
+
+    public:
+        explicit Random(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next() {
+            std::uint64_t z = (this->state += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform enough in [0, bound) for small bounds
+        std::uint64_t below(std::uint64_t bound) {
+            return this->next() % bound;
+        }
+
+        // Fisher-Yates
+        template <class T>
+        void shuffle(std::span<T> elements) {
+            for (std::size_t i = elements.size(); i > 1; i--) {
+                std::swap(elements[i - 1], elements[this->below(i)]);
+            }
+        }
+    };
 }
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#include "benchmark.h"
+#include "engine/solver.h"
+#include "serialization.h"
+#include "utils.h"
+
+using sudoku_engine::BenchmarkHeuristic;
+using sudoku_engine::BenchmarkOptions;
+using sudoku_engine::BenchmarkResult;
+using sudoku_engine::utils::getSeconds;
+using sudoku_engine::utils::Timer;
+
+// A metric the baseline is held to
+struct BenchmarkMetric {
+    std::string_view name;
+    std::function<double(const BenchmarkResult&)> get;
+    // Step counts only change with the search, times also with the machine
+    bool is_time;
+    bool higher_is_better;
+};
+
+static const std::array<BenchmarkMetric, 9> BENCHMARK_METRICS = {{
+    {"Solved", [](const auto& r) { return double(r.solved_count); }, false,
+     true},
+    {"P50 Time", [](const auto& r) { return r.p50_time; }, true, false},
+    {"P90 Time", [](const auto& r) { return r.p90_time; }, true, false},
+    {"P99 Time", [](const auto& r) { return r.p99_time; }, true, false},
+    {"Mean CPU Time", [](const auto& r) { return r.mean_cpu_time; }, true,
+     false},
+    {"Nodes per Second", [](const auto& r) { return r.nodes_per_second; },
+     true, true},
+    {"P50 Steps", [](const auto& r) { return double(r.p50_steps); }, false,
+     false},
+    {"P99 Steps", [](const auto& r) { return double(r.p99_steps); }, false,
+     false},
+    {"Max Steps", [](const auto& r) { return double(r.max_steps); }, false,
+     false},
+}};
+
+static constexpr std::string_view BENCHMARK_CSV_HEADER =
+    "Bundle,Heuristic,Puzzles,Solved,P50 Time,P90 Time,P99 Time,Max Time,"
+    "Mean Time,Mean CPU Time,P50 Steps,P99 Steps,Max Steps,Nodes per Second";
+
+void sudoku_engine::writeBenchmarkResults(
+    std::ostream& output,
+    std::span<const BenchmarkResult> results
+) {
+    output << BENCHMARK_CSV_HEADER << '\n';
+    for (const BenchmarkResult& r : results) {
+        output << r.bundle << ',' << r.heuristic << ',' << r.puzzle_count
+               << ',' << r.solved_count << ',' << r.p50_time << ','
+               << r.p90_time << ',' << r.p99_time << ',' << r.max_time << ','
+               << r.mean_time << ',' << r.mean_cpu_time << ',' << r.p50_steps
+               << ',' << r.p99_steps << ',' << r.max_steps << ','
+               << r.nodes_per_second << '\n';
+    }
+}
+
+std::vector<BenchmarkResult> sudoku_engine::readBenchmarkResults(
+    std::istream& input
+) {
+    std::vector<BenchmarkResult> results;
+    std::string line;
+    if (!std::getline(input, line) || line != BENCHMARK_CSV_HEADER) {
+        throw std::runtime_error("Not a benchmark results file");
+    }
+
+    while (std::getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::array<std::string, 14> values;
+        for (std::string& value : values) {
+            if (!std::getline(fields, value, ',')) {
+                throw std::runtime_error("Short benchmark results row");
+            }
+        }
+
+        results.push_back({
+            .bundle = values[0],
+            .heuristic = values[1],
+            .puzzle_count = std::stoull(values[2]),
+            .solved_count = std::stoull(values[3]),
+            .p50_time = std::stod(values[4]),
+            .p90_time = std::stod(values[5]),
+            .p99_time = std::stod(values[6]),
+            .max_time = std::stod(values[7]),
+            .mean_time = std::stod(values[8]),
+            .mean_cpu_time = std::stod(values[9]),
+            .p50_steps = std::stoull(values[10]),
+            .p99_steps = std::stoull(values[11]),
+            .max_steps = std::stoull(values[12]),
+            .nodes_per_second = std::stod(values[13])
+        });
+    }
+
+    return results;
+}
+
+// Rank-based, the same way the batch summary takes its P99
+template <class T>
+static T getPercentile(const std::vector<T>& sorted, unsigned percent) {
+    if (sorted.empty()) {
+        return T();
+    }
+    const std::size_t rank = (sorted.size() * percent + 99) / 100;
+    return sorted[std::max<std::size_t>(rank, 1) - 1];
+}
+
+BenchmarkResult sudoku_engine::benchmarkBundle(
+    const std::string& filename,
+    const BenchmarkHeuristic& heuristic,
+    const BenchmarkOptions& options
+) {
+    using sudoku_engine::serialization::MappedPuzzleLoader;
+
+    const MappedPuzzleLoader loader(filename);
+    const std::size_t puzzle_count = std::min<std::size_t>(
+        loader.puzzle_count(),
+        options.puzzle_limit.value_or(loader.puzzle_count())
+    );
+
+    Board board;
+    const auto search = heuristic.factory(board);
+    Solver solver;
+    std::vector<BoardCage> cages;
+    BoardState<BoardCell> solution(BOARD_SIZE, CELL_EMPTY);
+
+    struct Sample {
+        double time;
+        double cpu_time;
+        std::size_t steps;
+        bool solved;
+    };
+
+    const auto solve = [&](std::size_t index) {
+        const auto puzzle = loader.view_puzzle(index);
+        puzzle.decode_cages(cages);
+        puzzle.decode_solution(solution);
+
+        board.setCages(cages);
+        board.clearValues();
+        search->reset();
+
+        const double start = getSeconds(Timer::WALL_CLOCK);
+        const double cpu_start = getSeconds(Timer::THREAD_CPU);
+        const SearchStatus status = solver.solve(*search);
+        const double cpu_end = getSeconds(Timer::THREAD_CPU);
+        const double end = getSeconds(Timer::WALL_CLOCK);
+
+        const bool solved = status == SearchStatus::SOLVED &&
+                            !board.isIncomplete() && !board.isInvalid();
+        if (status == SearchStatus::SOLVED && !solved) {
+            throw std::runtime_error(
+                heuristic.name + " gave an invalid solution to puzzle #" +
+                std::to_string(index)
+            );
+        }
+        return Sample{
+            end - start, cpu_end - cpu_start, search->getStepCount(), solved
+        };
+    };
+
+    for (std::size_t i = 0; i < std::min(options.warmup_count, puzzle_count);
+         i++) {
+        solve(i);
+    }
+
+    // Whole passes rather than back to back repeats, so no puzzle is timed
+    // with its own data still in cache
+    std::vector<std::vector<Sample>> samples(
+        puzzle_count, std::vector<Sample>()
+    );
+    for (std::size_t pass = 0; pass < options.repeat_count; pass++) {
+        for (std::size_t i = 0; i < puzzle_count; i++) {
+            samples[i].push_back(solve(i));
+        }
+    }
+
+    BenchmarkResult result;
+    result.bundle = std::filesystem::path(filename).stem().string();
+    result.heuristic = heuristic.name;
+    result.puzzle_count = puzzle_count;
+
+    std::vector<double> times;
+    std::vector<std::size_t> steps;
+    double total_time = 0;
+    double total_cpu_time = 0;
+    for (std::vector<Sample>& puzzle_samples : samples) {
+        // Searches are deterministic, only the times differ between passes
+        if (!puzzle_samples.front().solved) {
+            continue;
+        }
+
+        std::sort(
+            puzzle_samples.begin(),
+            puzzle_samples.end(),
+            [](const Sample& a, const Sample& b) { return a.time < b.time; }
+        );
+        const Sample& median = puzzle_samples[puzzle_samples.size() / 2];
+        times.push_back(median.time);
+        steps.push_back(median.steps);
+        total_time += median.time;
+        total_cpu_time += median.cpu_time;
+    }
+
+    result.solved_count = times.size();
+    if (times.empty()) {
+        return result;
+    }
+
+    std::sort(times.begin(), times.end());
+    std::sort(steps.begin(), steps.end());
+    result.p50_time = getPercentile(times, 50);
+    result.p90_time = getPercentile(times, 90);
+    result.p99_time = getPercentile(times, 99);
+    result.max_time = times.back();
+    result.mean_time = total_time / times.size();
+    result.mean_cpu_time = total_cpu_time / times.size();
+    result.p50_steps = getPercentile(steps, 50);
+    result.p99_steps = getPercentile(steps, 99);
+    result.max_steps = steps.back();
+
+    std::size_t total_steps = 0;
+    for (const std::size_t count : steps) {
+        total_steps += count;
+    }
+    result.nodes_per_second =
+        total_cpu_time > 0 ? total_steps / total_cpu_time : 0;
+    return result;
+}
+
+std::vector<BenchmarkResult> sudoku_engine::runBenchmarks(
+    std::span<const std::string> bundles,
+    std::span<const BenchmarkHeuristic> heuristics,
+    const BenchmarkOptions& options,
+    std::ostream& output
+) {
+    output << std::left << std::setw(14) << "Bundle" << std::setw(20)
+           << "Heuristic" << std::right << std::setw(8) << "Solved"
+           << std::setw(10) << "P50 ms" << std::setw(10) << "P90 ms"
+           << std::setw(10) << "P99 ms" << std::setw(10) << "Max ms"
+           << std::setw(10) << "P99 Step" << std::setw(12) << "Nodes/s"
+           << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    for (const std::string& bundle : bundles) {
+        for (const BenchmarkHeuristic& heuristic : heuristics) {
+            const BenchmarkResult& r = results.emplace_back(
+                benchmarkBundle(bundle, heuristic, options)
+            );
+
+            output << std::left << std::setw(14) << r.bundle << std::setw(20)
+                   << r.heuristic << std::right << std::setw(8)
+                   << r.solved_count << std::fixed << std::setprecision(3)
+                   << std::setw(10) << r.p50_time * 1000 << std::setw(10)
+                   << r.p90_time * 1000 << std::setw(10) << r.p99_time * 1000
+                   << std::setw(10) << r.max_time * 1000 << std::setw(10)
+                   << r.p99_steps << std::setprecision(0) << std::setw(12)
+                   << r.nodes_per_second << std::defaultfloat
+                   << std::setprecision(6) << std::endl;
+        }
+    }
+
+    return results;
+}
+
+bool sudoku_engine::compareBenchmarkResults(
+    std::span<const BenchmarkResult> results,
+    std::span<const BenchmarkResult> baseline,
+    const BenchmarkOptions& options,
+    std::ostream& output
+) {
+    bool regressed = false;
+
+    for (const BenchmarkResult& result : results) {
+        const auto base = std::find_if(
+            baseline.begin(), baseline.end(), [&](const BenchmarkResult& b) {
+                return b.bundle == result.bundle &&
+                       b.heuristic == result.heuristic;
+            }
+        );
+        if (base == baseline.end()) {
+            output << "[INFO] No baseline for " << result.bundle << ' '
+                   << result.heuristic << "." << std::endl;
+            continue;
+        }
+        if (base->puzzle_count != result.puzzle_count) {
+            output << "[WARN] Baseline for " << result.bundle << ' '
+                   << result.heuristic << " ran " << base->puzzle_count
+                   << " puzzles, not " << result.puzzle_count << "."
+                   << std::endl;
+        }
+
+        for (const BenchmarkMetric& metric : BENCHMARK_METRICS) {
+            if (metric.is_time && !options.max_time_regression) {
+                continue;
+            }
+
+            const double old_value = metric.get(*base);
+            const double new_value = metric.get(result);
+            const double allowed = (metric.is_time ?
+                                        *options.max_time_regression :
+                                        options.max_step_regression) /
+                                   100;
+
+            const bool is_worse =
+                metric.higher_is_better ?
+                    new_value < old_value * (1 - allowed) :
+                    new_value > old_value * (1 + allowed);
+            if (!is_worse) {
+                continue;
+            }
+
+            regressed = true;
+            output << "[REGRESSION] " << result.bundle << ' '
+                   << result.heuristic << ' ' << metric.name << ": "
+                   << old_value << " -> " << new_value;
+            if (old_value != 0) {
+                output << " (" << std::showpos
+                       << (new_value / old_value - 1) * 100 << std::noshowpos
+                       << "%)";
+            }
+            output << std::endl;
+        }
+    }
+
+    return regressed;
+}
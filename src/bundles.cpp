@@ -0,0 +1,157 @@
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bundles.h"
+#include "utils.h"
+
+using sudoku_engine::BoardCage;
+using sudoku_engine::BoardCell;
+using sudoku_engine::BoardState;
+using sudoku_engine::Generator;
+using sudoku_engine::serialization::BundleFormat;
+using sudoku_engine::serialization::Puzzle;
+using sudoku_engine::serialization::PuzzleView;
+using sudoku_engine::serialization::PuzzleWriter;
+using sudoku_engine::utils::getSeconds;
+using sudoku_engine::utils::Random;
+using sudoku_engine::utils::Timer;
+
+void sudoku_engine::generateBundle(
+    const BundleGeneratorOptions& options,
+    std::ostream& output,
+    BundleFormat format,
+    std::ostream& log
+) {
+    PuzzleWriter writer(output, options.puzzle_count, format);
+    std::size_t cage_count = 0;
+
+    // Puzzles are written as soon as every one before them is done
+    std::mutex write_mutex;
+    std::deque<std::unique_ptr<Puzzle>> pending_puzzles;
+    std::uint32_t next_write = 0;
+
+    std::atomic<std::uint32_t> next_index = 0;
+    std::atomic<std::size_t> given_up = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+
+    const auto generate_puzzles = [&]() {
+        Generator generator(options.generator);
+
+        while (!failed) {
+            const std::uint32_t index = next_index++;
+            if (index >= options.puzzle_count) {
+                break;
+            }
+
+            Random seeds(options.seed ^ (std::uint64_t(index) << 32));
+            std::unique_ptr<Puzzle> puzzle;
+            for (std::size_t attempt = 0; !puzzle; attempt++) {
+                if (attempt == options.max_attempts) {
+                    throw std::runtime_error(
+                        "Gave up on puzzle " + std::to_string(index) +
+                        " after " + std::to_string(attempt) + " attempts"
+                    );
+                }
+                puzzle = generator.generate(seeds.next());
+                if (!puzzle) {
+                    given_up++;
+                }
+            }
+
+            std::lock_guard lock(write_mutex);
+            const std::uint32_t slot = index - next_write;
+            if (pending_puzzles.size() <= slot) {
+                pending_puzzles.resize(slot + 1);
+            }
+            pending_puzzles[slot] = std::move(puzzle);
+
+            while (!pending_puzzles.empty() && pending_puzzles.front()) {
+                writer.save_puzzle(*pending_puzzles.front());
+                cage_count += pending_puzzles.front()->cages.size();
+                pending_puzzles.pop_front();
+                next_write++;
+            }
+            if (format == BundleFormat::TEXT) {
+                output.flush();
+            }
+        }
+    };
+
+    // A worker that throws stops the others, and the first error is
+    // rethrown once they've all returned
+    const auto run_worker = [&]() {
+        try {
+            generate_puzzles();
+        } catch (...) {
+            std::lock_guard lock(write_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    };
+
+    const double start = getSeconds(Timer::WALL_CLOCK);
+    if (options.thread_count > 1) {
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 0; i < options.thread_count; i++) {
+            threads.emplace_back(run_worker);
+        }
+    } else {
+        run_worker();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    writer.finish();
+    const double end = getSeconds(Timer::WALL_CLOCK);
+
+    log << std::endl;
+    log << "Puzzles Generated:   " << options.puzzle_count << std::endl;
+    log << "Puzzles Given Up:    " << given_up << std::endl;
+    if (options.puzzle_count > 0) {
+        log << "Avg. Cage Count:     "
+            << cage_count / static_cast<double>(options.puzzle_count)
+            << std::endl;
+    }
+    log << "Wall Time:           " << end - start << " seconds" << std::endl;
+    log << "Puzzles per Second:  " << options.puzzle_count / (end - start)
+        << std::endl;
+}
+
+void sudoku_engine::convertBundle(
+    const serialization::MappedPuzzleLoader& loader,
+    std::ostream& output,
+    BundleFormat format
+) {
+    PuzzleWriter writer(output, loader.puzzle_count(), format);
+    std::vector<BoardCage> cages;
+    for (std::uint32_t i = 0; i < loader.puzzle_count(); i++) {
+        const PuzzleView view = loader.view_puzzle(i);
+        view.decode_cages(cages);
+
+        Puzzle puzzle{
+            .cages = utils::ArrayVector<BoardCage>(cages.size()),
+            .solution = BoardState<BoardCell>(
+                BOARD_SIZE,
+                std::vector<BoardCell>(
+                    view.solution().begin(), view.solution().end()
+                )
+            )
+        };
+        for (const BoardCage& cage : cages) {
+            puzzle.cages.append(cage);
+        }
+        writer.save_puzzle(puzzle);
+    }
+    writer.finish();
+}
@@ -67,6 +67,46 @@ const Board::LineOrBox& Board::getBox(BoardOffset index) const {
     return box_cache->at(index);
 }
 
+const Board::Peers& Board::getPeers(const BoardPosition& pos) const {
+    using PeersCache =
+        std::array<Peers, std::size_t(BOARD_SIZE) * BOARD_SIZE>;
+
+    static const auto peer_cache = ([]() {
+        auto peers = std::make_unique<PeersCache>();
+
+        BoardPosition p;
+        for (p.row = 0; p.row < BOARD_SIZE; p.row++) {
+            for (p.col = 0; p.col < BOARD_SIZE; p.col++) {
+                Peers& cell_peers = peers->at(p.toOffset());
+                std::size_t i = 0;
+
+                for (BoardOffset col = 0; col < BOARD_SIZE; col++) {
+                    if (col != p.col)
+                        cell_peers[i++] = {p.row, col};
+                }
+                for (BoardOffset row = 0; row < BOARD_SIZE; row++) {
+                    if (row != p.row)
+                        cell_peers[i++] = {row, p.col};
+                }
+                // Box cells outside the row and column
+                const BoardOffset start_row = (p.row / 3) * 3;
+                const BoardOffset start_col = (p.col / 3) * 3;
+                for (BoardOffset row = start_row; row < start_row + 3; row++) {
+                    for (BoardOffset col = start_col; col < start_col + 3;
+                         col++) {
+                        if (row != p.row && col != p.col)
+                            cell_peers[i++] = {row, col};
+                    }
+                }
+            }
+        }
+
+        return peers;
+    })();
+
+    return peer_cache->at(pos.toOffset());
+}
+
 bool Board::isInvalid() const {
     return this->hasInvalidLines() || this->hasInvalidBoxes() ||
            this->hasInvalidCages();
@@ -165,28 +205,330 @@ bool Board::hasInvalidCages() const {
     return false;
 }
 
-bool Board::isInvalid(const BoardPosition& pos) const {
-    if (this->isInvalidRow(pos.row) || this->isInvalidCol(pos.col)) {
+bool Board::breaksSum(
+    const CageState& state,
+    unsigned target,
+    BoardCell value
+) {
+    // Same bounds as isInvalidCage(), applied after placing value
+    const unsigned new_sum = state.sum + value;
+    if (new_sum > target) {
         return true;
     }
 
-    const BoardOffset box_index = this->getCellBox(pos);
-    if (this->isInvalidLineOrBox(this->getBox(box_index))) {
-        return true;
+    const unsigned empty_left = state.empty_count - 1u;
+    const unsigned remaining = target - new_sum;
+    if (empty_left == 0) {
+        return remaining != 0;
     }
 
-    const BoardCage* const cage = this->cell_cages[pos];
-    if (cage != nullptr && this->isInvalidCage(*cage)) {
+    return remaining < empty_left || remaining > CELL_MAX * empty_left;
+}
+
+bool Board::isInvalid(const BoardPosition& pos, BoardCell value) const {
+    const BoardCellMask value_mask = toCellMask(value);
+
+    if ((this->getUsedMask(pos) & value_mask) != 0) {
         return true;
     }
 
+    if (const BoardCage* const cage = this->cell_cages[pos]) {
+        const CageState& state = this->getCageState(*cage);
+        if ((state.used & value_mask) != 0 ||
+            breaksSum(state, cage->sum, value)) {
+            return true;
+        }
+    }
+
+    for (const DerivedIndex index : this->getCellDerivedSums(pos)) {
+        const DerivedSum& derived = this->derived_sums[index];
+        const CageState& state = this->derived_states[index];
+        if ((derived.distinct && (state.used & value_mask) != 0) ||
+            breaksSum(state, derived.sum, value)) {
+            return true;
+        }
+    }
+
     return false;
 }
 
+void Board::setValue(const BoardPosition& pos, BoardCell value) {
+    if (this->cell_values[pos] != CELL_EMPTY) {
+        this->clearValue(pos);
+    }
+
+    const BoardCellMask value_mask = toCellMask(value);
+
+    this->cell_values[pos] = value;
+    this->row_used[pos.row] |= value_mask;
+    this->col_used[pos.col] |= value_mask;
+    this->box_used[this->getCellBox(pos)] |= value_mask;
+    this->empty_count--;
+
+    const auto place = [&](CageState& state) {
+        state.used |= value_mask;
+        state.sum += value;
+        state.empty_count--;
+    };
+
+    if (const BoardCage* const cage = this->cell_cages[pos]) {
+        place(this->cage_states[this->getCageIndex(*cage)]);
+    }
+
+    for (const DerivedIndex index : this->getCellDerivedSums(pos)) {
+        place(this->derived_states[index]);
+    }
+}
+
+void Board::clearValue(const BoardPosition& pos) {
+    const BoardCell value = this->cell_values[pos];
+    if (value == CELL_EMPTY) {
+        return;
+    }
+
+    const BoardCellMask value_mask = toCellMask(value);
+
+    this->cell_values[pos] = CELL_EMPTY;
+    this->row_used[pos.row] &= ~value_mask;
+    this->col_used[pos.col] &= ~value_mask;
+    this->box_used[this->getCellBox(pos)] &= ~value_mask;
+    this->empty_count++;
+
+    const auto unplace = [&](CageState& state) {
+        state.used &= ~value_mask;
+        state.sum -= value;
+        state.empty_count++;
+    };
+
+    if (const BoardCage* const cage = this->cell_cages[pos]) {
+        unplace(this->cage_states[this->getCageIndex(*cage)]);
+    }
+
+    for (const DerivedIndex index : this->getCellDerivedSums(pos)) {
+        unplace(this->derived_states[index]);
+    }
+}
+
+void Board::rebuildUnitState() {
+    this->row_used.fill(0);
+    this->col_used.fill(0);
+    this->box_used.fill(0);
+    this->empty_count = 0;
+
+    this->cage_states.assign(this->cages.size(), CageState{0, 0, 0});
+    this->derived_states.assign(
+        this->derived_sums.size(), CageState{0, 0, 0}
+    );
+
+    BoardPosition pos;
+    for (pos.row = 0; pos.row < BOARD_SIZE; pos.row++) {
+        for (pos.col = 0; pos.col < BOARD_SIZE; pos.col++) {
+            const BoardCell value = this->cell_values[pos];
+            const BoardCage* const cage = this->cell_cages[pos];
+
+            const auto add = [&](CageState& state) {
+                if (value == CELL_EMPTY) {
+                    state.empty_count++;
+                } else {
+                    state.used |= toCellMask(value);
+                    state.sum += value;
+                }
+            };
+
+            if (cage != nullptr) {
+                add(this->cage_states[this->getCageIndex(*cage)]);
+            }
+
+            for (const DerivedIndex index : this->getCellDerivedSums(pos)) {
+                add(this->derived_states[index]);
+            }
+
+            if (value == CELL_EMPTY) {
+                this->empty_count++;
+                continue;
+            }
+
+            const BoardCellMask value_mask = toCellMask(value);
+            this->row_used[pos.row] |= value_mask;
+            this->col_used[pos.col] |= value_mask;
+            this->box_used[this->getCellBox(pos)] |= value_mask;
+        }
+    }
+}
+
+void Board::deriveSums() {
+    constexpr std::size_t CELL_COUNT = std::size_t(BOARD_SIZE) * BOARD_SIZE;
+    constexpr long UNIT_SUM = (CELL_MIN + CELL_MAX) * BOARD_SIZE / 2;
+
+    using CellSet = std::bitset<CELL_COUNT>;
+
+    this->derived_sums.clear();
+
+    CellSet caged;
+    std::vector<CellSet> cage_sets(this->cages.size());
+    for (std::size_t i = 0; i < this->cages.size(); i++) {
+        for (const auto& pos : this->cages[i].cells) {
+            cage_sets[i].set(pos.toOffset());
+        }
+        caged |= cage_sets[i];
+    }
+
+    std::vector<CellSet> derived_sets;
+
+    const auto shares_unit = [&](const std::vector<BoardPosition>& cells) {
+        bool same_row = true, same_col = true, same_box = true;
+        bool same_cage = this->cell_cages[cells.front()] != nullptr;
+        for (const auto& pos : cells) {
+            same_row &= pos.row == cells.front().row;
+            same_col &= pos.col == cells.front().col;
+            same_box &= this->getCellBox(pos) == this->getCellBox(cells[0]);
+            same_cage &= this->cell_cages[pos] == this->cell_cages[cells[0]];
+        }
+        return same_row || same_col || same_box || same_cage;
+    };
+
+    const auto add_sum = [&](const CellSet& cells, long sum) {
+        const long count = static_cast<long>(cells.count());
+        if (count == 0 || count > long(MAX_DERIVED_CELLS) ||
+            this->derived_sums.size() >= MAX_DERIVED_SUMS) {
+            return;
+        }
+
+        // Puzzles whose cages contradict the rule have no solution anyway,
+        // that's for the search to find out
+        if (sum < CELL_MIN * count || sum > CELL_MAX * count) {
+            return;
+        }
+
+        // A cage already says the same thing
+        for (const auto& cage_set : cage_sets) {
+            if (cage_set == cells) {
+                return;
+            }
+        }
+        for (const auto& derived_set : derived_sets) {
+            if (derived_set == cells) {
+                return;
+            }
+        }
+
+        std::vector<BoardPosition> positions;
+        positions.reserve(static_cast<std::size_t>(count));
+        for (std::size_t offset = 0; offset < CELL_COUNT; offset++) {
+            if (cells.test(offset)) {
+                positions.emplace_back(
+                    static_cast<BoardOffset>(offset / BOARD_SIZE),
+                    static_cast<BoardOffset>(offset % BOARD_SIZE)
+                );
+            }
+        }
+
+        const bool distinct = shares_unit(positions);
+        this->derived_sums.push_back(DerivedSum{
+            .cells = std::move(positions),
+            .sum = static_cast<unsigned>(sum),
+            .distinct = distinct
+        });
+        derived_sets.push_back(cells);
+    };
+
+    // A region made of whole units adds up to 45 per unit. Cages entirely
+    // inside it leave the innies to make up the difference, and cages
+    // sticking out of it force the sum of the outies.
+    const auto add_region = [&](const CellSet& region, long unit_count) {
+        long inside_sum = 0;
+        long crossing_sum = 0;
+        CellSet innies = region;
+        CellSet outies;
+
+        for (std::size_t i = 0; i < this->cages.size(); i++) {
+            const CellSet overlap = cage_sets[i] & region;
+            if (overlap.none()) {
+                continue;
+            }
+            if (overlap == cage_sets[i]) {
+                inside_sum += this->cages[i].sum;
+                innies &= ~cage_sets[i];
+            } else {
+                crossing_sum += this->cages[i].sum;
+                outies |= cage_sets[i] & ~region;
+            }
+        }
+
+        const long innie_sum = UNIT_SUM * unit_count - inside_sum;
+        add_sum(innies, innie_sum);
+
+        // Only if the innies are exactly the crossing cages' cells
+        if ((region & ~caged).none()) {
+            add_sum(outies, crossing_sum - innie_sum);
+        }
+    };
+
+    const auto unit_set = [](const Board::LineOrBox& unit) {
+        CellSet cells;
+        for (const auto& pos : unit) {
+            cells.set(pos.toOffset());
+        }
+        return cells;
+    };
+
+    // Runs of adjacent rows and of adjacent columns, short of the whole board
+    for (BoardOffset start = 0; start < BOARD_SIZE; start++) {
+        CellSet rows, cols;
+        for (BoardOffset end = start;
+             end < BOARD_SIZE && end - start + 1 < BOARD_SIZE;
+             end++) {
+            rows |= unit_set(this->getRow(end));
+            cols |= unit_set(this->getCol(end));
+            add_region(rows, end - start + 1);
+            add_region(cols, end - start + 1);
+        }
+    }
+
+    // Single boxes and pairs of neighbouring boxes
+    for (BoardOffset box = 0; box < BOARD_SIZE; box++) {
+        const CellSet cells = unit_set(this->getBox(box));
+        add_region(cells, 1);
+
+        if (box % BOX_SIZE != BOX_SIZE - 1) {
+            add_region(cells | unit_set(this->getBox(box + 1)), 2);
+        }
+        if (box + BOX_SIZE < BOARD_SIZE) {
+            add_region(cells | unit_set(this->getBox(box + BOX_SIZE)), 2);
+        }
+    }
+
+    // Index the derived sums by cell
+    std::array<std::vector<DerivedIndex>, CELL_COUNT> per_cell;
+    for (std::size_t i = 0; i < this->derived_sums.size(); i++) {
+        for (const auto& pos : this->derived_sums[i].cells) {
+            per_cell[pos.toOffset()].push_back(static_cast<DerivedIndex>(i));
+        }
+    }
+
+    this->cell_derived.clear();
+    for (std::size_t offset = 0; offset < CELL_COUNT; offset++) {
+        this->cell_derived_start[offset] =
+            static_cast<std::uint16_t>(this->cell_derived.size());
+        this->cell_derived.insert(
+            this->cell_derived.end(),
+            per_cell[offset].begin(),
+            per_cell[offset].end()
+        );
+    }
+    this->cell_derived_start[CELL_COUNT] =
+        static_cast<std::uint16_t>(this->cell_derived.size());
+}
+
 void Board::setCages(const std::span<const BoardCage>& new_cages) {
     this->cages = new_cages;
     this->cell_cages.reset(nullptr);
     for (const auto& cage : this->cages) {
+        // Cage values are distinct, so no more than 9 cells fit, and the
+        // searches size their per-cage buffers by that
+        if (cage.cells.empty() || cage.cells.size() > BOARD_SIZE) {
+            throw std::runtime_error("Cages must have 1 to 9 cells");
+        }
         for (const auto& cell_pos : cage.cells) {
             if (this->cell_cages[cell_pos] != nullptr) {
                 throw std::runtime_error("Overlapping cages detected");
@@ -194,6 +536,9 @@ void Board::setCages(const std::span<const BoardCage>& new_cages) {
             this->cell_cages[cell_pos] = &cage;
         }
     }
+
+    this->deriveSums();
+    this->rebuildUnitState();
 }
 
 void Board::print(std::ostream& output) const {
@@ -0,0 +1,43 @@
+#include <bit>
+
+#include "engine/combinations.h"
+
+using sudoku_engine::CageCombinations;
+
+static constexpr CageCombinations::Table buildTable() {
+    using sudoku_engine::BoardCellMask;
+
+    constexpr unsigned ALL_DIGITS = CageCombinations::MASK_COUNT - 1;
+
+    CageCombinations::Table table{};
+
+    // Every digit subset contributes to every used mask disjoint from it,
+    // which is 3^9 updates in total
+    for (unsigned digits = 1; digits <= ALL_DIGITS; digits++) {
+        unsigned sum = 0;
+        for (unsigned bit = 0; bit < sudoku_engine::BOARD_SIZE; bit++) {
+            if (digits & (1u << bit)) {
+                sum += bit + 1;
+            }
+        }
+
+        const unsigned cells = static_cast<unsigned>(std::popcount(digits));
+        const unsigned free_digits = ALL_DIGITS & ~digits;
+
+        // Enumerate all submasks of free_digits, including 0
+        unsigned used = free_digits;
+        while (true) {
+            const std::size_t index =
+                CageCombinations::toIndex(sum, cells, BoardCellMask(used));
+            table[index] |= BoardCellMask(digits);
+            if (used == 0) {
+                break;
+            }
+            used = (used - 1) & free_digits;
+        }
+    }
+
+    return table;
+}
+
+constinit const CageCombinations::Table CageCombinations::table = buildTable();
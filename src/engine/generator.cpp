@@ -0,0 +1,394 @@
+#include <bit>
+#include <numeric>
+
+#include "engine/generator.h"
+
+using sudoku_engine::BOARD_SIZE;
+using sudoku_engine::BoardCellMask;
+using sudoku_engine::BoardOffset;
+using sudoku_engine::BoardPosition;
+using sudoku_engine::Generator;
+using sudoku_engine::GeneratorOptions;
+using sudoku_engine::SearchBudget;
+using sudoku_engine::SearchStatus;
+using sudoku_engine::serialization::Puzzle;
+
+static BoardPosition toPosition(std::size_t offset) {
+    return {
+        static_cast<BoardOffset>(offset / BOARD_SIZE),
+        static_cast<BoardOffset>(offset % BOARD_SIZE)
+    };
+}
+
+// Lowest set bit of a random rank among the set bits of mask
+static BoardCellMask pickBit(BoardCellMask mask, std::size_t rank) {
+    for (; rank > 0; rank--) {
+        mask &= mask - 1;
+    }
+    return static_cast<BoardCellMask>(mask & -mask);
+}
+
+Generator::Generator(GeneratorOptions options)
+    : options(options), random(0), grid(), cell_cages(),
+      heuristic(
+          this->board,
+          options.step_limit,
+          PropagationHeuristic::ValueOrder::NATURAL,
+          {}
+      ) {
+    // A second solution is all it takes to rule a puzzle out
+    SearchBudget budget = this->heuristic.getBudget();
+    budget.solution_limit = 2;
+    this->heuristic.setBudget(budget);
+}
+
+std::unique_ptr<Puzzle> Generator::generate(std::uint64_t seed) {
+    this->random = utils::Random(seed);
+
+    this->fillGrid();
+    this->partitionCages();
+
+    // Every split adds a cage, so this ends at the latest once every cell
+    // is a cage of its own
+    while (true) {
+        const Uniqueness uniqueness = this->checkUniqueness();
+        if (uniqueness == Uniqueness::UNIQUE) {
+            break;
+        }
+        if (uniqueness == Uniqueness::UNKNOWN) {
+            return nullptr;
+        }
+
+        // Split up the cages around cells the other solution got wrong
+        std::array<std::size_t, CELL_COUNT> differences;
+        std::size_t difference_count = 0;
+        const auto& values = this->board.getValues();
+        for (std::size_t offset = 0; offset < CELL_COUNT; offset++) {
+            if (values[toPosition(offset)] != this->grid[offset]) {
+                differences[difference_count++] = offset;
+            }
+        }
+
+        // The solver only kept the second solution it found, which can be
+        // the generated grid itself, so any shared cage will do
+        if (difference_count == 0) {
+            for (std::size_t offset = 0; offset < CELL_COUNT; offset++) {
+                if (this->cages[this->cell_cages[offset]].cells.size() > 1) {
+                    differences[difference_count++] = offset;
+                }
+            }
+        }
+
+        this->splitCage(differences[this->random.below(difference_count)]);
+    }
+
+    for (std::size_t i = 0; i < this->options.merge_attempts; i++) {
+        this->tryMerge();
+    }
+
+    auto puzzle = std::unique_ptr<Puzzle>(new Puzzle{
+        .cages = utils::ArrayVector<BoardCage>(this->cages.size()),
+        .solution = BoardState<BoardCell>(
+            BOARD_SIZE,
+            std::vector<BoardCell>(this->grid.begin(), this->grid.end())
+        )
+    });
+    for (const BoardCage& cage : this->cages) {
+        puzzle->cages.append(cage);
+    }
+
+    return puzzle;
+}
+
+void Generator::fillGrid() {
+    constexpr BoardCellMask ALL_VALUES = toCellRangeMask(CELL_MIN, CELL_MAX);
+
+    std::array<BoardCellMask, BOARD_SIZE> row_used{};
+    std::array<BoardCellMask, BOARD_SIZE> col_used{};
+    std::array<BoardCellMask, BOARD_SIZE> box_used{};
+    // Values not yet tried at each cell up to the current one
+    std::array<BoardCellMask, CELL_COUNT> untried;
+
+    const auto get_box = [](std::size_t row, std::size_t col) {
+        return (row / BOX_SIZE) * BOX_SIZE + col / BOX_SIZE;
+    };
+    const auto toggle = [&](std::size_t offset, BoardCellMask mask) {
+        const std::size_t row = offset / BOARD_SIZE;
+        const std::size_t col = offset % BOARD_SIZE;
+        row_used[row] ^= mask;
+        col_used[col] ^= mask;
+        box_used[get_box(row, col)] ^= mask;
+    };
+    const auto get_free = [&](std::size_t offset) {
+        const std::size_t row = offset / BOARD_SIZE;
+        const std::size_t col = offset % BOARD_SIZE;
+        return static_cast<BoardCellMask>(
+            ALL_VALUES &
+            ~(row_used[row] | col_used[col] | box_used[get_box(row, col)])
+        );
+    };
+
+    std::size_t offset = 0;
+    untried[0] = ALL_VALUES;
+    while (offset < CELL_COUNT) {
+        // Dead end, take back the previous value and try another one there
+        if (untried[offset] == 0) {
+            offset--;
+            toggle(offset, toCellMask(this->grid[offset]));
+            continue;
+        }
+
+        const BoardCellMask pick = pickBit(
+            untried[offset],
+            this->random.below(std::popcount(untried[offset]))
+        );
+        untried[offset] &= ~pick;
+
+        this->grid[offset] = BoardCell(CELL_MIN + std::countr_zero(pick));
+        toggle(offset, pick);
+
+        if (++offset < CELL_COUNT) {
+            untried[offset] = get_free(offset);
+        }
+    }
+}
+
+void Generator::partitionCages() {
+    constexpr std::uint8_t NO_CAGE = UINT8_MAX;
+
+    std::array<std::uint8_t, CELL_COUNT> order;
+    std::iota(order.begin(), order.end(), 0);
+    this->random.shuffle(std::span<std::uint8_t>(order));
+
+    this->cell_cages.fill(NO_CAGE);
+    std::uint8_t cage_count = 0;
+
+    for (const std::size_t start : order) {
+        if (this->cell_cages[start] != NO_CAGE) {
+            continue;
+        }
+
+        // Single cells are givens, so they only come from cells boxed in by
+        // other cages
+        const std::size_t max_size = this->options.max_cage_size;
+        const std::size_t target_size =
+            max_size <= 1 ? 1 : 2 + this->random.below(max_size - 1);
+
+        std::array<std::size_t, BOARD_SIZE> cells;
+        std::size_t size = 0;
+        BoardCellMask used = 0;
+
+        const auto add_cell = [&](std::size_t offset) {
+            this->cell_cages[offset] = cage_count;
+            cells[size++] = offset;
+            used |= toCellMask(this->grid[offset]);
+        };
+        add_cell(start);
+
+        while (size < target_size) {
+            // Free neighbours whose digit the cage doesn't have yet
+            std::array<std::size_t, 4 * BOARD_SIZE> frontier;
+            std::size_t frontier_size = 0;
+            for (std::size_t i = 0; i < size; i++) {
+                std::array<std::size_t, 4> neighbours;
+                const std::size_t count = getNeighbours(cells[i], neighbours);
+                for (std::size_t j = 0; j < count; j++) {
+                    const std::size_t offset = neighbours[j];
+                    if (this->cell_cages[offset] == NO_CAGE &&
+                        (used & toCellMask(this->grid[offset])) == 0) {
+                        frontier[frontier_size++] = offset;
+                    }
+                }
+            }
+
+            if (frontier_size == 0) {
+                break;
+            }
+            add_cell(frontier[this->random.below(frontier_size)]);
+        }
+
+        cage_count++;
+    }
+
+    this->rebuildCages();
+}
+
+void Generator::splitCage(std::size_t offset) {
+    const std::uint8_t old_cage = this->cell_cages[offset];
+    const std::size_t old_size = this->cages[old_cage].cells.size();
+    if (old_size <= 1) {
+        return;
+    }
+
+    // Grow a connected part from the cell, the rest of the old cage falls
+    // apart into its own connected parts when the cages are rebuilt
+    const auto new_cage = static_cast<std::uint8_t>(this->cages.size());
+    const std::size_t part_size = 1 + this->random.below(old_size - 1);
+
+    std::array<std::size_t, BOARD_SIZE> part;
+    std::size_t size = 0;
+    this->cell_cages[offset] = new_cage;
+    part[size++] = offset;
+
+    while (size < part_size) {
+        std::array<std::size_t, 4 * BOARD_SIZE> frontier;
+        std::size_t frontier_size = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            std::array<std::size_t, 4> neighbours;
+            const std::size_t count = getNeighbours(part[i], neighbours);
+            for (std::size_t j = 0; j < count; j++) {
+                if (this->cell_cages[neighbours[j]] == old_cage) {
+                    frontier[frontier_size++] = neighbours[j];
+                }
+            }
+        }
+
+        if (frontier_size == 0) {
+            break;
+        }
+
+        const std::size_t next = frontier[this->random.below(frontier_size)];
+        this->cell_cages[next] = new_cage;
+        part[size++] = next;
+    }
+
+    this->rebuildCages();
+}
+
+bool Generator::tryMerge() {
+    const std::size_t offset = this->random.below(CELL_COUNT);
+    const std::uint8_t cage = this->cell_cages[offset];
+
+    const auto get_used = [this](std::uint8_t index) {
+        BoardCellMask used = 0;
+        for (const BoardPosition& pos : this->cages[index].cells) {
+            used |= toCellMask(this->grid[pos.toOffset()]);
+        }
+        return used;
+    };
+
+    // Neighbouring cages that fit alongside it, with none of its digits
+    std::array<std::uint8_t, 4 * BOARD_SIZE> others;
+    std::size_t other_count = 0;
+    const BoardCellMask used = get_used(cage);
+    for (const BoardPosition& pos : this->cages[cage].cells) {
+        std::array<std::size_t, 4> neighbours;
+        const std::size_t count = getNeighbours(pos.toOffset(), neighbours);
+        for (std::size_t i = 0; i < count; i++) {
+            const std::uint8_t other = this->cell_cages[neighbours[i]];
+            if (other != cage &&
+                this->cages[cage].cells.size() +
+                        this->cages[other].cells.size() <=
+                    this->options.max_cage_size &&
+                (used & get_used(other)) == 0) {
+                others[other_count++] = other;
+            }
+        }
+    }
+
+    if (other_count == 0) {
+        return false;
+    }
+
+    const std::uint8_t other = others[this->random.below(other_count)];
+    const CellCages old_cell_cages = this->cell_cages;
+    for (std::uint8_t& cell_cage : this->cell_cages) {
+        if (cell_cage == other) {
+            cell_cage = cage;
+        }
+    }
+    this->rebuildCages();
+
+    if (this->checkUniqueness() == Uniqueness::UNIQUE) {
+        return true;
+    }
+
+    this->cell_cages = old_cell_cages;
+    this->rebuildCages();
+    return false;
+}
+
+void Generator::rebuildCages() {
+    constexpr std::uint8_t UNVISITED = UINT8_MAX;
+
+    CellCages regions;
+    regions.fill(UNVISITED);
+    this->cages.clear();
+
+    // Flood fill each region of cells sharing a cage, in offset order so
+    // the numbering doesn't depend on the old one
+    for (std::size_t start = 0; start < CELL_COUNT; start++) {
+        if (regions[start] != UNVISITED) {
+            continue;
+        }
+
+        const auto region = static_cast<std::uint8_t>(this->cages.size());
+        std::vector<BoardPosition> cells;
+        unsigned sum = 0;
+
+        std::array<std::size_t, BOARD_SIZE> stack;
+        std::size_t stack_size = 0;
+        regions[start] = region;
+        stack[stack_size++] = start;
+
+        while (stack_size > 0) {
+            const std::size_t offset = stack[--stack_size];
+            cells.push_back(toPosition(offset));
+            sum += this->grid[offset];
+
+            std::array<std::size_t, 4> neighbours;
+            const std::size_t count = getNeighbours(offset, neighbours);
+            for (std::size_t i = 0; i < count; i++) {
+                const std::size_t next = neighbours[i];
+                if (regions[next] == UNVISITED &&
+                    this->cell_cages[next] == this->cell_cages[start]) {
+                    regions[next] = region;
+                    stack[stack_size++] = next;
+                }
+            }
+        }
+
+        this->cages.emplace_back(sum, std::move(cells));
+    }
+
+    this->cell_cages = regions;
+    this->board.setCages(this->cages);
+}
+
+Generator::Uniqueness Generator::checkUniqueness() {
+    this->board.clearValues();
+    this->heuristic.reset();
+
+    const SearchStatus status = this->heuristic.solve();
+    if (status == SearchStatus::SOLVED) {
+        return Uniqueness::AMBIGUOUS;
+    }
+    if (status == SearchStatus::UNSATISFIABLE &&
+        this->heuristic.getSolutionCount() == 1) {
+        return Uniqueness::UNIQUE;
+    }
+    return Uniqueness::UNKNOWN;
+}
+
+std::size_t Generator::getNeighbours(
+    std::size_t offset,
+    std::array<std::size_t, 4>& neighbours
+) {
+    const std::size_t row = offset / BOARD_SIZE;
+    const std::size_t col = offset % BOARD_SIZE;
+
+    std::size_t count = 0;
+    if (row > 0) {
+        neighbours[count++] = offset - BOARD_SIZE;
+    }
+    if (row + 1 < BOARD_SIZE) {
+        neighbours[count++] = offset + BOARD_SIZE;
+    }
+    if (col > 0) {
+        neighbours[count++] = offset - 1;
+    }
+    if (col + 1 < BOARD_SIZE) {
+        neighbours[count++] = offset + 1;
+    }
+    return count;
+}
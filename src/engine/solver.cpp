@@ -3,12 +3,13 @@
 
 #include "engine/solver.h"
 
+using sudoku_engine::SearchStatus;
 using sudoku_engine::Solver;
 
 Solver::Solver() = default;
 
 Solver::~Solver() = default;
 
-bool Solver::solve(Heuristic& heuristic) {
+SearchStatus Solver::solve(Heuristic& heuristic) {
     return heuristic.solve();
 }
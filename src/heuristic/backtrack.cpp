@@ -1,41 +1,263 @@
 #include "heuristic/backtrack.h"
+#include "heuristic/parallel.h"
 
 using sudoku_engine::BacktrackHeuristic;
+using sudoku_engine::BoardCellDomain;
+using sudoku_engine::BoardPosition;
+using sudoku_engine::CandidateQueue;
+using sudoku_engine::SearchPhase;
+using sudoku_engine::SearchPool;
+using sudoku_engine::SearchStatus;
+using sudoku_engine::TraceEventType;
 
-bool BacktrackHeuristic::solve() {
-    return this->expand({0, 0});
+SearchStatus BacktrackHeuristic::solve() {
+    this->depth = 0;
+    this->scheduleRestart();
+
+    if (this->trace != nullptr) {
+        BoardState<BoardCellDomain> domains(BOARD_SIZE, BoardCellDomain());
+        this->getTraceDomains(domains);
+        this->trace->begin(this->board.getValues(), domains);
+    }
+
+    // Solved right away if the board is already full, which is also the
+    // only solution
+    if (const auto status = this->pushFrame()) {
+        if (*status == SearchStatus::SOLVED && !this->foundSolution()) {
+            return SearchStatus::UNSATISFIABLE;
+        }
+        return *status;
+    }
+
+    while (this->depth > 0) {
+        SearchFrame& frame = this->frames[this->depth - 1];
+
+        // Backtrack out of the previously tried value, if any
+        if (frame.value != CELL_EMPTY) {
+            this->stats.measure(SearchPhase::PROPAGATE, [&]() {
+                this->undoValue(frame.pos, frame.trail_mark);
+            });
+            frame.value = CELL_EMPTY;
+        }
+
+        if (frame.candidates.empty()) {
+            this->stats.recordBacktrack();
+            this->traceEvent(TraceEventType::BACKTRACK, frame.pos);
+            this->depth--;
+            continue;
+        }
+
+        frame.value = frame.candidates.pop();
+        this->stats.recordNode(this->depth);
+        const bool is_legal =
+            this->stats.measure(SearchPhase::PROPAGATE, [&]() {
+                return this->applyValue(frame.pos, frame.value);
+            });
+        if (!is_legal) {
+            continue;
+        }
+
+        // This run has used up its steps, start over along another path
+        if (this->step_count >= this->restart_step) {
+            this->restart();
+        }
+
+        // Descend, we're done once there are no cells left, unless
+        // there are more solutions to count
+        if (const auto status = this->pushFrame()) {
+            if (*status != SearchStatus::SOLVED || this->foundSolution()) {
+                return *status;
+            }
+        }
+    }
+
+    return SearchStatus::UNSATISFIABLE;
 }
 
-bool BacktrackHeuristic::expand(const BoardPosition& pos) {
-    // If we've filled all rows, we're done
-    if (pos.row == BOARD_SIZE) {
-        return true;
+bool BacktrackHeuristic::foundSolution() {
+    if (this->pool != nullptr) {
+        this->solution_count++;
+        return this->pool->addSolution();
+    }
+    return this->recordSolution();
+}
+
+std::optional<SearchStatus> BacktrackHeuristic::pushFrame() {
+    const BoardPosition pos = this->stats.measure(SearchPhase::SELECT, [&]() {
+        return this->selectCell();
+    });
+    if (pos.row >= BOARD_SIZE) {
+        return SearchStatus::SOLVED;
     }
 
     this->step_count++;
-    this->checkStepLimit();
+    if (const auto status = this->checkBudget()) {
+        return status;
+    }
+    if (this->pool != nullptr &&
+        this->step_count % SearchPool::STEP_BATCH == 0 && !this->syncPool()) {
+        return SearchStatus::BUDGET_EXHAUSTED;
+    }
 
-    auto& cell_value = this->board.getValues()[pos];
+    this->frames[this->depth++] = {
+        .pos = pos,
+        .value = CELL_EMPTY,
+        .candidates = this->stats.measure(
+            SearchPhase::ORDER, [&]() { return this->orderValues(pos); }
+        ),
+        .trail_mark = this->getTrailMark()
+    };
 
-    // Skip cells that are already filled
-    if (cell_value != CELL_EMPTY) {
-        return this->expand(this->incrementPos(pos));
+    return std::nullopt;
+}
+
+void BacktrackHeuristic::restart() {
+    while (this->depth > 0) {
+        const SearchFrame& frame = this->frames[--this->depth];
+        if (frame.value != CELL_EMPTY) {
+            this->undoValue(frame.pos, frame.trail_mark);
+        }
     }
 
-    // Try placing numbers 1-9
-    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
-        cell_value = num;
+    this->scheduleRestart();
+}
+
+void BacktrackHeuristic::scheduleRestart() {
+    // Subtrees given away to a parallel search would be searched again, and
+    // solutions already counted would be counted again
+    if (this->pool != nullptr || this->budget.solution_limit > 1) {
+        this->restart_step = std::numeric_limits<std::size_t>::max();
+        return;
+    }
 
-        if (this->board.isInvalid(pos)) {
-            cell_value = CELL_EMPTY;
+    const std::size_t cutoff = this->getRestartCutoff();
+    this->restart_step =
+        cutoff > std::numeric_limits<std::size_t>::max() - this->step_count ?
+            std::numeric_limits<std::size_t>::max() :
+            this->step_count + cutoff;
+}
+
+SearchStatus BacktrackHeuristic::solveTask(
+    std::span<const SearchAssignment> path
+) {
+    std::array<std::size_t, MAX_DEPTH> trail_marks;
+    std::size_t applied = 0;
+    bool is_legal = true;
+
+    while (is_legal && applied < path.size()) {
+        trail_marks[applied] = this->getTrailMark();
+        is_legal = this->applyValue(path[applied].pos, path[applied].value);
+        applied++;
+    }
+
+    this->task_path = path;
+    const SearchStatus status =
+        is_legal ? this->solve() : SearchStatus::UNSATISFIABLE;
+    if (status != SearchStatus::UNSATISFIABLE) {
+        return status;
+    }
+
+    while (applied > 0) {
+        applied--;
+        this->undoValue(path[applied].pos, trail_marks[applied]);
+    }
+
+    return status;
+}
+
+bool BacktrackHeuristic::syncPool() {
+    if (!this->pool->addSteps(SearchPool::STEP_BATCH)) {
+        return false;
+    }
+
+    if (this->pool->isHungry()) {
+        this->shareWork();
+    }
+    return true;
+}
+
+void BacktrackHeuristic::shareWork() {
+    // Give away the untried values of the shallowest node that has any,
+    // since those are likely the largest subtrees
+    for (std::size_t i = 0; i < this->depth; i++) {
+        SearchFrame& frame = this->frames[i];
+        if (frame.candidates.empty()) {
             continue;
         }
-        
-        if (this->expand(this->incrementPos(pos))) {
-            return true;
+
+        SearchPool::Task task;
+        for (const auto& assignment : this->task_path) {
+            task.append(assignment);
+        }
+        for (std::size_t j = 0; j < i; j++) {
+            task.append({this->frames[j].pos, this->frames[j].value});
+        }
+
+        const std::size_t prefix_length = task.length;
+        while (!frame.candidates.empty()) {
+            task.length = prefix_length;
+            task.append({frame.pos, frame.candidates.pop()});
+            this->pool->push(this->pool_worker, task);
+        }
+        return;
+    }
+}
+
+BoardPosition BacktrackHeuristic::selectCell() const {
+    const BoardPosition* const current = this->getCurrentPos();
+    BoardPosition pos = current != nullptr ? incrementPos(*current) :
+                                             BoardPosition(0, 0);
+
+    // Skip cells that are already filled
+    while (pos.row < BOARD_SIZE &&
+           this->board.getValues()[pos] != CELL_EMPTY) {
+        pos = incrementPos(pos);
+    }
+
+    return pos;
+}
+
+CandidateQueue BacktrackHeuristic::orderValues(const BoardPosition& pos) {
+    CandidateQueue candidates;
+
+    // Try placing numbers 1-9, skipping the ones its units already use
+    const BoardCellMask used = this->board.getUsedMask(pos);
+    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
+        if ((used & toCellMask(num)) == 0 &&
+            !this->board.isInvalid(pos, num)) {
+            candidates.push(num);
         }
     }
 
-    cell_value = CELL_EMPTY;
-    return false;
+    return candidates;
+}
+
+bool BacktrackHeuristic::applyValue(
+    const BoardPosition& pos,
+    BoardCell value
+) {
+    this->traceEvent(TraceEventType::ASSIGN, pos, value);
+    this->board.setValue(pos, value);
+    return true;
+}
+
+void BacktrackHeuristic::undoValue(
+    const BoardPosition& pos,
+    std::size_t /* trail_mark */
+) {
+    this->traceEvent(TraceEventType::UNASSIGN, pos);
+    this->board.clearValue(pos);
+}
+
+void BacktrackHeuristic::getTraceDomains(
+    BoardState<BoardCellDomain>& domains
+) const {
+    BoardPosition pos = {0, 0};
+    for (pos.row = 0; pos.row < BOARD_SIZE; pos.row++) {
+        for (pos.col = 0; pos.col < BOARD_SIZE; pos.col++) {
+            const BoardCell value = this->board.getValues()[pos];
+            domains[pos] = value != CELL_EMPTY ? BoardCellDomain{value} :
+                                                 ~BoardCellDomain();
+        }
+    }
 }
@@ -0,0 +1,281 @@
+#include <array>
+#include <bit>
+
+#include "engine/combinations.h"
+#include "heuristic/dlx.h"
+
+using sudoku_engine::DlxHeuristic;
+using sudoku_engine::SearchStatus;
+
+DlxHeuristic::DlxHeuristic(Board& board, std::size_t step_limit)
+    : Heuristic(board, step_limit) {}
+
+SearchStatus DlxHeuristic::solve() {
+    this->build();
+
+    std::size_t depth = 0;
+    bool descend = true;
+
+    while (true) {
+        if (descend) {
+            // Every column is covered, so the chosen options are a solution
+            if (this->nodes[ROOT].right == ROOT) {
+                if (this->recordSolution()) {
+                    this->writeSolution(depth);
+                    return SearchStatus::SOLVED;
+                }
+            } else {
+                const NodeIndex column = this->chooseColumn();
+
+                this->step_count++;
+                if (const auto status = this->checkBudget()) {
+                    return *status;
+                }
+
+                this->cover(column);
+                this->chosen[depth++] = column;
+            }
+        }
+
+        NodeIndex& node = this->chosen[depth - 1];
+        const NodeIndex column = this->nodes[node].column;
+
+        // Backtrack out of the previously tried option, if any
+        if (node != column) {
+            this->uncoverOption(node);
+        }
+
+        node = this->nodes[node].down;
+        if (node == column) {
+            this->stats.recordBacktrack();
+            this->uncover(column);
+            if (--depth == 0) {
+                return SearchStatus::UNSATISFIABLE;
+            }
+            descend = false;
+            continue;
+        }
+
+        this->stats.recordNode(depth);
+        this->coverOption(node);
+        descend = true;
+    }
+}
+
+void DlxHeuristic::build() {
+    const auto cages = this->board.getCages();
+    const auto& cell_values = this->board.getValues();
+
+    const std::size_t column_count =
+        CAGE_COLUMNS + cages.size() * COLUMNS_PER_CAGE;
+
+    this->nodes.clear();
+    this->options.clear();
+    this->column_sizes.assign(toHeader(column_count), 0);
+    // Every option covers at least one column, so a solution can't take
+    // more of them than there are columns
+    this->chosen.resize(column_count);
+
+    this->nodes.push_back({ROOT, ROOT, ROOT, ROOT, ROOT, 0});
+    for (std::size_t i = 0; i < column_count; i++) {
+        const NodeIndex header = toHeader(i);
+        const NodeIndex last = this->nodes[ROOT].left;
+
+        this->nodes.push_back({last, ROOT, header, header, header, 0});
+        this->nodes[last].right = header;
+        this->nodes[ROOT].left = header;
+    }
+
+    // A cell option for every value that some combination of its cage
+    // allows and no filled cell already rules out
+    for (BoardOffset row = 0; row < BOARD_SIZE; row++) {
+        for (BoardOffset col = 0; col < BOARD_SIZE; col++) {
+            const BoardPosition pos(row, col);
+            const auto cage = this->board.getCellCage(pos);
+            const std::size_t box = this->board.getCellBox(pos);
+
+            BoardCellMask allowed = static_cast<BoardCellMask>(
+                toCellRangeMask(CELL_MIN, CELL_MAX) &
+                ~this->board.getUsedMask(pos)
+            );
+            if (cell_values[pos] != CELL_EMPTY) {
+                allowed = toCellMask(cell_values[pos]);
+            } else if (cage != nullptr) {
+                allowed &= CageCombinations::candidates(
+                    cage->sum, unsigned(cage->cells.size()), 0
+                );
+            }
+
+            for (BoardCell value = CELL_MIN; value <= CELL_MAX; value++) {
+                if ((allowed & toCellMask(value)) == 0) {
+                    continue;
+                }
+
+                const std::size_t digit = value - CELL_MIN;
+                std::array<NodeIndex, 5> columns = {
+                    toHeader(CELL_COLUMNS + pos.toOffset()),
+                    toHeader(ROW_VALUE_COLUMNS + row * BOARD_SIZE + digit),
+                    toHeader(COL_VALUE_COLUMNS + col * BOARD_SIZE + digit),
+                    toHeader(BOX_VALUE_COLUMNS + box * BOARD_SIZE + digit),
+                    0
+                };
+                std::size_t count = 4;
+
+                if (cage != nullptr) {
+                    const std::size_t cage_column =
+                        CAGE_COLUMNS +
+                        this->board.getCageIndex(*cage) * COLUMNS_PER_CAGE;
+                    columns[count++] = toHeader(cage_column + 1 + digit);
+                }
+
+                this->addOption(
+                    {pos, value}, std::span(columns).first(count)
+                );
+            }
+        }
+    }
+
+    // A combination option for every set of distinct digits that fills its
+    // cage with the right sum, covering the digits it leaves out
+    for (std::size_t i = 0; i < cages.size(); i++) {
+        const auto& cage = cages[i];
+        const std::size_t cage_column = CAGE_COLUMNS + i * COLUMNS_PER_CAGE;
+
+        // Board::setCages() rejects empty cages, but a combination option
+        // needs a cell to name, so don't rely on that alone
+        if (cage.cells.empty()) {
+            continue;
+        }
+
+        for (unsigned mask = 0; mask < CageCombinations::MASK_COUNT; mask++) {
+            if (std::size_t(std::popcount(mask)) != cage.cells.size()) {
+                continue;
+            }
+
+            unsigned sum = 0;
+            for (unsigned rest = mask; rest != 0; rest &= rest - 1) {
+                sum += CELL_MIN + std::countr_zero(rest);
+            }
+            if (sum != cage.sum) {
+                continue;
+            }
+
+            std::array<NodeIndex, COLUMNS_PER_CAGE> columns;
+            std::size_t count = 0;
+
+            columns[count++] = toHeader(cage_column);
+            for (std::size_t digit = 0; digit < BOARD_SIZE; digit++) {
+                if ((mask & (1u << digit)) == 0) {
+                    columns[count++] = toHeader(cage_column + 1 + digit);
+                }
+            }
+
+            this->addOption(
+                {cage.cells.front(), CELL_EMPTY},
+                std::span(columns).first(count)
+            );
+        }
+    }
+}
+
+void DlxHeuristic::addOption(
+    const Option& option,
+    std::span<const NodeIndex> columns
+) {
+    const auto option_index = static_cast<NodeIndex>(this->options.size());
+    const auto first = static_cast<NodeIndex>(this->nodes.size());
+    this->options.push_back(option);
+
+    for (std::size_t i = 0; i < columns.size(); i++) {
+        const NodeIndex column = columns[i];
+        const auto index = static_cast<NodeIndex>(first + i);
+
+        // Linked in a ring with the other nodes of the option, and at the
+        // bottom of its column
+        this->nodes.push_back({
+            .left = i == 0 ? NodeIndex(first + columns.size() - 1) :
+                             NodeIndex(index - 1),
+            .right = i + 1 == columns.size() ? first : NodeIndex(index + 1),
+            .up = this->nodes[column].up,
+            .down = column,
+            .column = column,
+            .option = option_index
+        });
+        this->nodes[this->nodes[column].up].down = index;
+        this->nodes[column].up = index;
+        this->column_sizes[column]++;
+    }
+}
+
+DlxHeuristic::NodeIndex DlxHeuristic::chooseColumn() const {
+    // The column with the fewest options left branches the least
+    NodeIndex best = this->nodes[ROOT].right;
+    for (NodeIndex column = best; column != ROOT;
+         column = this->nodes[column].right) {
+        if (this->column_sizes[column] < this->column_sizes[best]) {
+            best = column;
+            if (this->column_sizes[best] == 0) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+void DlxHeuristic::cover(NodeIndex column) {
+    Node& header = this->nodes[column];
+    this->nodes[header.right].left = header.left;
+    this->nodes[header.left].right = header.right;
+
+    for (NodeIndex i = header.down; i != column; i = this->nodes[i].down) {
+        for (NodeIndex j = this->nodes[i].right; j != i;
+             j = this->nodes[j].right) {
+            const Node& node = this->nodes[j];
+            this->nodes[node.down].up = node.up;
+            this->nodes[node.up].down = node.down;
+            this->column_sizes[node.column]--;
+        }
+    }
+}
+
+void DlxHeuristic::uncover(NodeIndex column) {
+    Node& header = this->nodes[column];
+
+    for (NodeIndex i = header.up; i != column; i = this->nodes[i].up) {
+        for (NodeIndex j = this->nodes[i].left; j != i;
+             j = this->nodes[j].left) {
+            const Node& node = this->nodes[j];
+            this->column_sizes[node.column]++;
+            this->nodes[node.down].up = j;
+            this->nodes[node.up].down = j;
+        }
+    }
+
+    this->nodes[header.right].left = column;
+    this->nodes[header.left].right = column;
+}
+
+void DlxHeuristic::coverOption(NodeIndex node) {
+    for (NodeIndex j = this->nodes[node].right; j != node;
+         j = this->nodes[j].right) {
+        this->cover(this->nodes[j].column);
+    }
+}
+
+void DlxHeuristic::uncoverOption(NodeIndex node) {
+    for (NodeIndex j = this->nodes[node].left; j != node;
+         j = this->nodes[j].left) {
+        this->uncover(this->nodes[j].column);
+    }
+}
+
+void DlxHeuristic::writeSolution(std::size_t depth) {
+    for (std::size_t i = 0; i < depth; i++) {
+        const Option& option =
+            this->options[this->nodes[this->chosen[i]].option];
+        if (option.value != CELL_EMPTY &&
+            this->board.getValues()[option.pos] == CELL_EMPTY) {
+            this->board.setValue(option.pos, option.value);
+        }
+    }
+}
@@ -1,65 +1,128 @@
 #include <algorithm>
-#include <cassert>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <span>
 
+#include "engine/combinations.h"
 #include "heuristic/forward.h"
 
 using sudoku_engine::BoardCellDomain;
 using sudoku_engine::BoardPosition;
+using sudoku_engine::CageCombinations;
+using sudoku_engine::CandidateQueue;
 using sudoku_engine::ForwardHeuristic;
+using sudoku_engine::TraceEventType;
+
+// Stable like std::stable_sort, which takes its buffer from the heap. Only
+// a cell's values are ever sorted, few enough for insertion sort.
+template <class T, class Less>
+static void sortStable(std::span<T> values, Less less) {
+    for (std::size_t i = 1; i < values.size(); i++) {
+        const T value = values[i];
+        std::size_t j = i;
+        for (; j > 0 && less(value, values[j - 1]); j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+}
 
 ForwardHeuristic::ForwardHeuristic(
     Board& board,
     std::size_t step_limit,
     bool mrv,
-    bool lcv
+    ValueOrder value_order,
+    RestartPolicy restarts
 )
     : BacktrackHeuristic(board, step_limit),
-      cell_domains(BOARD_SIZE, ~BoardCellDomain()), mrv(mrv), lcv(lcv) {
+      cell_domains(BOARD_SIZE, ~BoardCellDomain()), trail(TRAIL_CAPACITY),
+      track_buckets(mrv), mrv(mrv), value_order(value_order),
+      restarts(restarts), random(restarts.seed) {
+    this->initDomains();
+}
+
+void ForwardHeuristic::reset() {
+    BacktrackHeuristic::reset();
+
+    this->cell_domains.reset(~BoardCellDomain());
+    this->trail.clear();
+    this->mrv_buckets.clear();
+    this->track_buckets = this->mrv;
+    this->initDomains();
+
+    // Every puzzle gets the same sequence, whichever puzzles came before
+    this->run_count = 0;
+    this->random = utils::Random(this->restarts.seed);
+}
+
+// Element i (from 1) of the Luby sequence: 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ...
+static std::size_t luby(std::size_t i) {
+    while (true) {
+        // Smallest k with 2^k - 1 >= i
+        std::size_t k = 1;
+        while ((std::size_t(1) << k) - 1 < i) {
+            k++;
+        }
+
+        if (i == (std::size_t(1) << k) - 1) {
+            return std::size_t(1) << (k - 1);
+        }
+        i -= (std::size_t(1) << (k - 1)) - 1;
+    }
+}
+
+std::size_t ForwardHeuristic::getRestartCutoff() {
+    constexpr std::size_t NEVER = std::numeric_limits<std::size_t>::max();
+    constexpr double GEOMETRIC_FACTOR = 1.5;
+
+    const std::size_t run = ++this->run_count;
+    const auto base = static_cast<double>(this->restarts.base_cutoff);
+
+    double cutoff;
+    switch (this->restarts.schedule) {
+        case RestartSchedule::LUBY:
+            cutoff = base * static_cast<double>(luby(run));
+            break;
+        case RestartSchedule::GEOMETRIC:
+            cutoff = base * std::pow(GEOMETRIC_FACTOR, double(run - 1));
+            break;
+        case RestartSchedule::NONE:
+        default:
+            return NEVER;
+    }
+
+    return cutoff >= static_cast<double>(NEVER) ?
+               NEVER :
+               static_cast<std::size_t>(cutoff);
+}
+
+void ForwardHeuristic::initDomains() {
     BoardPosition pos = {0, 0};
     for (pos.row = 0; pos.row < BOARD_SIZE; pos.row++) {
         for (pos.col = 0; pos.col < BOARD_SIZE; pos.col++) {
             if (auto val = this->board.getValues()[pos]; val != CELL_EMPTY) {
                 this->cell_domains[pos] = {val};
+            } else if (this->mrv) {
+                this->mrv_buckets.insert(
+                    pos.toOffset(), this->cell_domains[pos].size()
+                );
             }
         }
     }
 }
 
-ForwardHeuristic::RefinedDomains ForwardHeuristic::forwardCheck(
+ForwardHeuristic::Refinement ForwardHeuristic::forwardCheck(
     const BoardPosition& pos
-) const {
+) {
     const BoardCell new_value = this->board.getValues()[pos];
 
-    constexpr std::size_t ITERATION_DELTA_MIN = 9 + 8 + 4;
-
-    const auto cage = this->board.getCellCage(pos);
-
-    std::size_t delta_capacity = ITERATION_DELTA_MIN;
-    if (cage != nullptr) {
-        delta_capacity += cage->cells.size() - 1;
-    }
-
-    RefinedDomains result = {
-        .new_domains = DomainDeltas(delta_capacity),
-        .values_pruned = 0,
-        .is_legal = false
-    };
-
-    DomainDeltas& iteration_deltas = result.new_domains;
-    std::bitset<BOARD_SIZE * BOARD_SIZE> is_refined;
-
-    const auto refine_domain_raw = [&](const BoardPosition& p,
-                                       const BoardCellDomain& new_domain,
-                                       const BoardOffset delta_size) -> bool {
-        iteration_deltas.append({p, new_domain});
-        is_refined[p.toOffset()] = true;
-        result.values_pruned += delta_size;
-        return !new_domain.empty();
-    };
+    Refinement result = {.values_pruned = 0, .is_legal = false};
 
+    // Refinements are written straight into cell_domains and recorded on the
+    // trail, so the caller rewinds to its mark to undo them
     const auto refine_domain = [&](const BoardPosition& p) -> bool {
-        // Already-refined domains will be ignored...
-        if (is_refined[p.toOffset()])
+        if (p == pos)
             return true;
 
         auto domain = this->cell_domains[p];
@@ -68,12 +131,14 @@ ForwardHeuristic::RefinedDomains ForwardHeuristic::forwardCheck(
             return !domain.empty();
 
         domain.remove(new_value);
-        return refine_domain_raw(p, domain, 1);
+        this->refineDomain(p, domain);
+        result.values_pruned++;
+        return !domain.empty();
     };
 
-    refine_domain_raw(pos, {new_value}, 0);
+    this->refineDomain(pos, {new_value});
 
-    if (cage != nullptr) {
+    if (const auto cage = this->board.getCellCage(pos); cage != nullptr) {
         const auto cage_domain = this->getValidCageValues(*cage);
         for (const auto& p : cage->cells) {
             // Note that cage_domain only apply to empty cells!
@@ -90,9 +155,11 @@ ForwardHeuristic::RefinedDomains ForwardHeuristic::forwardCheck(
 
             domain = domain & cage_domain;
 
-            BoardOffset delta_size =
+            result.values_pruned +=
                 static_cast<BoardOffset>(old_domain.size() - domain.size());
-            if (!refine_domain_raw(p, domain, delta_size)) {
+            this->refineDomain(p, domain);
+
+            if (domain.empty()) {
                 return result;
             }
         }
@@ -119,6 +186,28 @@ ForwardHeuristic::RefinedDomains ForwardHeuristic::forwardCheck(
         }
     }
 
+    // Derived sums narrow their remaining cells to what can still add up
+    const auto derived_sums = this->board.getDerivedSums();
+    for (const auto index : this->board.getCellDerivedSums(pos)) {
+        const auto derived_domain = this->getValidDerivedValues(index);
+        for (const auto& p : derived_sums[index].cells) {
+            if (p == pos || this->board.getValues()[p] != CELL_EMPTY) {
+                continue;
+            }
+
+            const auto& old_domain = this->cell_domains[p];
+            const auto domain = old_domain & derived_domain;
+
+            result.values_pruned +=
+                static_cast<BoardOffset>(old_domain.size() - domain.size());
+            this->refineDomain(p, domain);
+
+            if (domain.empty()) {
+                return result;
+            }
+        }
+    }
+
     result.is_legal = true;
     return result;
 }
@@ -126,171 +215,256 @@ ForwardHeuristic::RefinedDomains ForwardHeuristic::forwardCheck(
 BoardCellDomain ForwardHeuristic::getValidCageValues(
     const BoardCage& cage
 ) const {
-    unsigned empty_cell_count = 0;
-    long remaining_sum = cage.sum;
-
-    for (const auto& cell_pos : cage.cells) {
-        const auto value = this->board.getValues()[cell_pos];
-        if (value == CELL_EMPTY) {
-            empty_cell_count++;
-        } else {
-            remaining_sum -= value;
-        }
-    }
+    const auto& cage_state = this->board.getCageState(cage);
 
-    if (empty_cell_count == 1) {
-        // Only one cell left: it must be equal to remaining_sum
-        if (remaining_sum >= CELL_MIN && remaining_sum <= CELL_MAX) {
-            return {static_cast<BoardCell>(remaining_sum)};
-        }
+    if (cage_state.sum > cage.sum) {
         return BoardCellDomain();
     }
 
-    BoardCellDomain valid_values;
-
-    const long min_remaining = (empty_cell_count - 1) * CELL_MIN;
-    const long max_remaining = (empty_cell_count - 1) * CELL_MAX;
+    // Only digits that complete some valid combination for the empty cells
+    return BoardCellDomain::fromMask(CageCombinations::candidates(
+        cage.sum - cage_state.sum, cage_state.empty_count, cage_state.used
+    ));
+}
 
-    // Check if each value could be part of a valid solution
-    for (BoardCell value = CELL_MIN; value <= CELL_MAX; value++) {
-        const long new_remaining = remaining_sum - value;
+BoardCellDomain ForwardHeuristic::getValidDerivedValues(
+    std::size_t index
+) const {
+    const auto& derived = this->board.getDerivedSums()[index];
+    const auto& derived_state = this->board.getDerivedState(index);
 
-        if (new_remaining < 0) {
-            continue;
-        }
+    if (derived_state.sum > derived.sum || derived_state.empty_count == 0) {
+        return BoardCellDomain();
+    }
 
-        if (new_remaining >= min_remaining && new_remaining <= max_remaining) {
-            valid_values.add(value);
-        }
+    const unsigned remaining = derived.sum - derived_state.sum;
+    if (derived.distinct) {
+        return BoardCellDomain::fromMask(CageCombinations::candidates(
+            remaining, derived_state.empty_count, derived_state.used
+        ));
     }
 
-    return valid_values;
+    // Values may repeat, so only the bounds of the other cells apply
+    const int others = derived_state.empty_count - 1;
+    return BoardCellDomain::fromMask(toCellRangeMask(
+        int(remaining) - CELL_MAX * others, int(remaining) - CELL_MIN * others
+    ));
 }
 
 BoardPosition ForwardHeuristic::findMrvCell() const {
-    const auto& cell_values = this->board.getValues();
-
-    constexpr BoardCell DOMAIN_SIZE_INF = BoardCell(~0);
-    static_assert(DOMAIN_SIZE_INF > CELL_MAX - CELL_MIN + 1);
+    const std::size_t tie_count = this->mrv_buckets.getMinCount();
+    const std::size_t skip = this->isRandomized() && tie_count > 1 ?
+                                 this->random.below(tie_count) :
+                                 0;
 
-    BoardPosition mrv_pos, p;
-    BoardCell min_domain_size = DOMAIN_SIZE_INF;
-    for (p.row = 0; p.row < BOARD_SIZE; p.row++) {
-        for (p.col = 0; p.col < BOARD_SIZE; p.col++) {
-            if (cell_values[p] != CELL_EMPTY) {
-                continue;
-            }
-            const auto domain_size = this->cell_domains[p].size();
-            if (domain_size < min_domain_size) {
-                min_domain_size = domain_size;
-                mrv_pos = p;
-            }
-        }
-    }
-
-    assert(min_domain_size > 0);
-    if (min_domain_size == DOMAIN_SIZE_INF) {
+    const std::size_t offset = this->mrv_buckets.findMin(skip);
+    if (offset >= std::size_t(BOARD_SIZE) * BOARD_SIZE) {
         // No empty cells left...
         return {BOARD_SIZE, BOARD_SIZE};
     }
 
-    return mrv_pos;
+    this->stats.recordMrvPick(this->mrv_buckets.getMinSize());
+    const BoardPosition pos = {
+        static_cast<BoardOffset>(offset / BOARD_SIZE),
+        static_cast<BoardOffset>(offset % BOARD_SIZE)
+    };
+    this->traceEvent(
+        TraceEventType::MRV_PICK,
+        pos,
+        static_cast<BoardCell>(this->mrv_buckets.getMinSize())
+    );
+    return pos;
+}
+
+BoardPosition ForwardHeuristic::selectCell() const {
+    if (this->mrv) {
+        return this->findMrvCell();
+    }
+    return BacktrackHeuristic::selectCell();
 }
 
-bool ForwardHeuristic::solve() {
-    if (!this->mrv) {
-        return this->expand({0, 0});
+CandidateQueue ForwardHeuristic::orderValues(const BoardPosition& pos) {
+    switch (this->value_order) {
+        case ValueOrder::LCV:
+            return this->orderValuesByForwardCheck(pos);
+        case ValueOrder::APPROX_LCV:
+            return this->orderValuesByPeerCount(pos);
+        case ValueOrder::NATURAL:
+            break;
+    }
+
+    // Forward checking happens lazily in applyValue(), most of the time the
+    // first value works out and the rest are never checked
+    std::array<BoardCell, BOARD_SIZE> values;
+    std::size_t value_count = 0;
+    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
+        if (this->cell_domains[pos].has(num) &&
+            !this->board.isInvalid(pos, num)) {
+            values[value_count++] = num;
+        }
     }
 
-    BoardPosition next_pos = this->findMrvCell();
+    const auto value_span = std::span(values).first(value_count);
+    this->shuffleTies(value_span);
 
-    if (next_pos.row >= BOARD_SIZE) {
-        // Board is already full
-        return true;
+    CandidateQueue candidates;
+    for (const BoardCell num : value_span) {
+        candidates.push(num);
     }
 
-    return this->expand(next_pos);
+    return candidates;
 }
 
-bool ForwardHeuristic::expand(const BoardPosition& pos) {
-    BoardPosition next_pos;
+CandidateQueue ForwardHeuristic::orderValuesByForwardCheck(
+    const BoardPosition& pos
+) {
+    // (value, values pruned) for each value that survives forward checking
+    using ChildRefinement = std::pair<BoardCell, BoardOffset>;
+    std::array<ChildRefinement, BOARD_SIZE> child_refinements;
+    std::size_t child_count = 0;
 
-    if (this->mrv) {
-        next_pos = this->findMrvCell();
+    const std::size_t trail_mark = this->trail.size();
 
-        if (next_pos.row >= BOARD_SIZE) {
-            // Board is full, we're done
-            return true;
+    // Every trial is rewound before the next one, so the buckets end up
+    // exactly where they started
+    const bool track_buckets = this->track_buckets;
+    this->track_buckets = false;
+
+    // Try placing numbers 1-9
+    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
+        if (!this->cell_domains[pos].has(num) ||
+            this->board.isInvalid(pos, num)) {
+            continue;
         }
-    } else {
-        if (pos.row == BOARD_SIZE) {
-            // We've filled all rows, we're done
-            return true;
+
+        const auto refinement = this->placeValue(pos, num);
+        this->removeValue(pos, trail_mark);
+
+        if (!refinement.is_legal) {
+            continue;
         }
 
-        next_pos = this->incrementPos(pos);
+        child_refinements[child_count++] =
+            std::make_pair(num, refinement.values_pruned);
     }
 
-    this->step_count++;
-    this->checkStepLimit();
+    this->track_buckets = track_buckets;
+
+    const auto refinement_span =
+        std::span(child_refinements).first(child_count);
+    this->shuffleTies(refinement_span);
 
-    auto& cell_value = this->board.getValues()[pos];
+    sortStable(
+        refinement_span,
+        [](const ChildRefinement& a, const ChildRefinement& b) -> bool {
+            return a.second < b.second;
+        }
+    );
 
-    // Skip cells that are already filled
-    if (cell_value != CELL_EMPTY) {
-        return this->expand(next_pos);
+    CandidateQueue candidates;
+    for (const auto& [num, values_pruned] : refinement_span) {
+        candidates.push(num);
     }
 
-    using ChildRefinement = std::pair<BoardCell, RefinedDomains>;
-    utils::ArrayVector<ChildRefinement> child_refinements(BOARD_SIZE);
+    return candidates;
+}
 
-    // Try placing numbers 1-9
-    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
-        cell_value = num;
+CandidateQueue ForwardHeuristic::orderValuesByPeerCount(
+    const BoardPosition& pos
+) const {
+    const auto& cell_values = this->board.getValues();
 
-        if (!this->cell_domains[pos].has(num) || this->board.isInvalid(pos)) {
-            cell_value = CELL_EMPTY;
-            continue;
+    // Number of empty peers that still have each value in their domain
+    std::array<BoardOffset, BOARD_SIZE> peer_counts = {};
+    const auto count_peer = [&](const BoardPosition& p) {
+        if (cell_values[p] != CELL_EMPTY) {
+            return;
         }
+        const BoardCellMask domain = this->cell_domains[p].toMask();
+        for (std::size_t i = 0; i < BOARD_SIZE; i++) {
+            peer_counts[i] += (domain >> i) & 1;
+        }
+    };
 
-        auto refinement = this->forwardCheck(pos);
-        if (!refinement.is_legal) {
-            continue;
+    for (const auto& p : this->board.getPeers(pos)) {
+        count_peer(p);
+    }
+
+    // Cage cells outside the row, column and box lose the value too
+    if (const auto cage = this->board.getCellCage(pos); cage != nullptr) {
+        const auto box = this->board.getCellBox(pos);
+        for (const auto& p : cage->cells) {
+            if (p.row != pos.row && p.col != pos.col &&
+                this->board.getCellBox(p) != box) {
+                count_peer(p);
+            }
         }
+    }
 
-        ChildRefinement&& child_refinement =
-            std::make_pair(std::move(num), std::move(refinement));
-        child_refinements.append(std::move(child_refinement));
+    std::array<BoardCell, BOARD_SIZE> values;
+    std::size_t value_count = 0;
+    for (BoardCell num = CELL_MIN; num <= CELL_MAX; num++) {
+        if (this->cell_domains[pos].has(num) &&
+            !this->board.isInvalid(pos, num)) {
+            values[value_count++] = num;
+        }
     }
 
-    cell_value = CELL_EMPTY;
+    const auto value_span = std::span(values).first(value_count);
+    this->shuffleTies(value_span);
 
-    const auto refinement_span = child_refinements.data();
+    sortStable(value_span, [&](BoardCell a, BoardCell b) -> bool {
+        return peer_counts[a - CELL_MIN] < peer_counts[b - CELL_MIN];
+    });
 
-    if (this->lcv) {
-        std::sort(
-            refinement_span.begin(),
-            refinement_span.end(),
-            [](const ChildRefinement& a, const ChildRefinement& b) -> bool {
-                return a.second.values_pruned < b.second.values_pruned;
-            }
-        );
+    CandidateQueue candidates;
+    for (const BoardCell num : value_span) {
+        candidates.push(num);
     }
 
-    for (auto& [num, refinement] : refinement_span) {
-        cell_value = num;
-        DomainDeltas unrefined =
-            this->applyDeltasWithBackup(std::move(refinement.new_domains));
+    return candidates;
+}
 
-        // Recursively try to fill the rest if legal
-        if (this->expand(next_pos)) {
-            return true;
-        }
+bool ForwardHeuristic::applyValue(const BoardPosition& pos, BoardCell value) {
+    return this->placeValue(pos, value).is_legal;
+}
+
+void ForwardHeuristic::undoValue(
+    const BoardPosition& pos,
+    std::size_t trail_mark
+) {
+    this->removeValue(pos, trail_mark);
+}
 
-        // Backtrack if this placement doesn't lead to a solution
-        cell_value = CELL_EMPTY;
-        this->applyDeltas(std::move(unrefined));
+ForwardHeuristic::Refinement ForwardHeuristic::placeValue(
+    const BoardPosition& pos,
+    BoardCell value
+) {
+    if (this->track_buckets) {
+        const auto size = this->cell_domains[pos].size();
+        this->mrv_buckets.erase(pos.toOffset(), size);
     }
+    this->traceEvent(TraceEventType::ASSIGN, pos, value);
+    this->board.setValue(pos, value);
+
+    const Refinement refinement = this->forwardCheck(pos);
+    this->stats.recordForwardCheck(
+        refinement.is_legal, refinement.values_pruned
+    );
+    return refinement;
+}
 
-    return false;
+void ForwardHeuristic::removeValue(
+    const BoardPosition& pos,
+    std::size_t trail_mark
+) {
+    // Restore the domains while pos is still filled, then put pos back in
+    // its bucket with the restored domain
+    this->traceEvent(TraceEventType::UNASSIGN, pos);
+    this->rewindTrail(trail_mark);
+    this->board.clearValue(pos);
+    if (this->track_buckets) {
+        const auto size = this->cell_domains[pos].size();
+        this->mrv_buckets.insert(pos.toOffset(), size);
+    }
 }
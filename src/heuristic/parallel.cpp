@@ -0,0 +1,211 @@
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "heuristic/parallel.h"
+
+using sudoku_engine::BacktrackHeuristic;
+using sudoku_engine::ParallelHeuristic;
+using sudoku_engine::SearchBudget;
+using sudoku_engine::SearchPool;
+using sudoku_engine::SearchStatus;
+
+SearchPool::SearchPool(
+    std::size_t worker_count,
+    std::size_t step_limit,
+    std::size_t solution_limit
+)
+    : queues(std::make_unique<Queue[]>(worker_count)),
+      worker_count(worker_count), step_limit(step_limit),
+      solution_limit(solution_limit) {}
+
+void SearchPool::push(std::size_t worker, const Task& task) {
+    // Counted as pending before anyone can take it, so the count never
+    // drops to zero while the task that split it off is still running
+    this->pending_tasks++;
+    this->queued_tasks++;
+
+    {
+        Queue& queue = this->queues[worker];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    this->wakeWorkers();
+}
+
+bool SearchPool::take(std::size_t worker, Task& task) {
+    bool idle = false;
+
+    while (!this->stop_source.stop_requested()) {
+        const std::uint32_t seen_version = this->version.load();
+
+        if (this->tryTake(worker, task)) {
+            if (idle) {
+                this->idle_workers--;
+            }
+            return true;
+        }
+
+        if (this->pending_tasks == 0) {
+            break;
+        }
+
+        if (!idle) {
+            idle = true;
+            this->idle_workers++;
+        }
+        this->version.wait(seen_version);
+    }
+
+    if (idle) {
+        this->idle_workers--;
+    }
+    return false;
+}
+
+bool SearchPool::tryTake(std::size_t worker, Task& task) {
+    // Own tasks from the back, then steal from the front of the others
+    for (std::size_t i = 0; i < this->worker_count; i++) {
+        Queue& queue = this->queues[(worker + i) % this->worker_count];
+        std::lock_guard lock(queue.mutex);
+
+        if (queue.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+
+        this->queued_tasks--;
+        return true;
+    }
+
+    return false;
+}
+
+void SearchPool::finishTask() {
+    if (--this->pending_tasks == 0) {
+        this->wakeWorkers();
+    }
+}
+
+void SearchPool::stop() {
+    this->stop_source.request_stop();
+    this->wakeWorkers();
+}
+
+void SearchPool::exhaustBudget() {
+    this->over_budget = true;
+    this->stop();
+}
+
+bool SearchPool::addSteps(std::size_t steps) {
+    if (this->step_count.fetch_add(steps) + steps > this->step_limit) {
+        this->exhaustBudget();
+        return false;
+    }
+    return true;
+}
+
+void SearchPool::wakeWorkers() {
+    this->version++;
+    this->version.notify_all();
+}
+
+ParallelHeuristic::ParallelHeuristic(
+    Board& board,
+    std::size_t step_limit,
+    std::size_t thread_count,
+    Factory factory
+)
+    : Heuristic(board, step_limit), thread_count(thread_count),
+      factory(std::move(factory)) {}
+
+SearchStatus ParallelHeuristic::solve() {
+    SearchPool pool(
+        this->thread_count,
+        this->budget.step_limit,
+        this->budget.solution_limit
+    );
+
+    // The pool enforces the shared step limit, everything else carries over
+    // to the workers, with the pool stopping them too
+    const std::stop_callback forward_stop(
+        this->budget.stop_token, [&pool]() { pool.stop(); }
+    );
+    SearchBudget worker_budget = this->budget;
+    worker_budget.step_limit = std::numeric_limits<std::size_t>::max();
+    worker_budget.stop_token = pool.getStopToken();
+
+    std::vector<Board> boards(this->thread_count, this->board);
+    std::vector<std::unique_ptr<BacktrackHeuristic>> workers;
+    for (std::size_t i = 0; i < this->thread_count; i++) {
+        workers.push_back(this->factory(boards[i]));
+        workers.back()->setBudget(worker_budget);
+        workers.back()->setSearchPool(&pool, i);
+    }
+
+    // The whole search tree, split up from there by whoever takes it
+    pool.push(0, SearchPool::Task());
+
+    // Worker that found a solution, if any
+    std::atomic<std::size_t> solver = this->thread_count;
+
+    const auto run_worker = [&](std::size_t worker) {
+        SearchPool::Task task;
+        while (pool.take(worker, task)) {
+            switch (workers[worker]->solveTask(task.getPath())) {
+            case SearchStatus::SOLVED: {
+                std::size_t none = this->thread_count;
+                if (solver.compare_exchange_strong(none, worker)) {
+                    pool.stop();
+                }
+                return;
+            }
+            case SearchStatus::UNSATISFIABLE:
+                pool.finishTask();
+                break;
+            case SearchStatus::BUDGET_EXHAUSTED:
+                pool.exhaustBudget();
+                return;
+            case SearchStatus::CANCELLED:
+                return;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 0; i < this->thread_count; i++) {
+            threads.emplace_back(run_worker, i);
+        }
+    }
+
+    this->step_count = 0;
+    this->solution_count = 0;
+    this->stats.reset();
+    for (const auto& worker : workers) {
+        this->step_count += worker->getStepCount();
+        this->solution_count += worker->getSolutionCount();
+        this->stats.merge(worker->getSearchStats());
+    }
+
+    if (solver < this->thread_count) {
+        this->board.setValues(boards[solver].getValues());
+        return SearchStatus::SOLVED;
+    }
+
+    if (pool.isOverBudget()) {
+        return SearchStatus::BUDGET_EXHAUSTED;
+    }
+    if (this->budget.stop_token.stop_requested()) {
+        return SearchStatus::CANCELLED;
+    }
+    return SearchStatus::UNSATISFIABLE;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "heuristic/portfolio.h"
+
+using sudoku_engine::PortfolioHeuristic;
+using sudoku_engine::SearchBudget;
+using sudoku_engine::SearchStatus;
+
+PortfolioHeuristic::PortfolioHeuristic(
+    Board& board,
+    std::size_t step_limit,
+    std::vector<Member> members
+)
+    : Heuristic(board, step_limit), members(std::move(members)),
+      winner(this->members.size()) {}
+
+SearchStatus PortfolioHeuristic::solve() {
+    const std::size_t member_count = this->members.size();
+
+    std::stop_source stop_source;
+    const std::stop_callback forward_stop(
+        this->budget.stop_token, [&stop_source]() {
+            stop_source.request_stop();
+        }
+    );
+
+    std::vector<Board> boards(member_count, this->board);
+    std::vector<std::unique_ptr<Heuristic>> heuristics;
+    for (std::size_t i = 0; i < member_count; i++) {
+        auto& heuristic =
+            heuristics.emplace_back(this->members[i].factory(boards[i]));
+
+        SearchBudget member_budget = this->budget;
+        member_budget.step_limit = heuristic->getBudget().step_limit;
+        member_budget.stop_token = stop_source.get_token();
+        heuristic->setBudget(member_budget);
+    }
+
+    std::atomic<std::size_t> first = member_count;
+    SearchStatus status = SearchStatus::BUDGET_EXHAUSTED;
+
+    const auto run_member = [&](std::size_t member) {
+        const SearchStatus member_status = heuristics[member]->solve();
+
+        // Proving there's no solution counts as finishing too
+        if (member_status != SearchStatus::SOLVED &&
+            member_status != SearchStatus::UNSATISFIABLE) {
+            return;
+        }
+
+        std::size_t none = member_count;
+        if (first.compare_exchange_strong(none, member)) {
+            status = member_status;
+            stop_source.request_stop();
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 0; i < member_count; i++) {
+            threads.emplace_back(run_member, i);
+        }
+    }
+
+    this->winner = first;
+    if (this->winner == member_count) {
+        // With no winner to take them from, the steps are what every member
+        // spent, as in a parallel search. Members search the same puzzle, so
+        // the solutions are only as many as the most any one found.
+        this->step_count = 0;
+        this->solution_count = 0;
+        this->stats.reset();
+        for (const auto& heuristic : heuristics) {
+            this->step_count += heuristic->getStepCount();
+            this->solution_count = std::max(
+                this->solution_count, heuristic->getSolutionCount()
+            );
+            this->stats.merge(heuristic->getSearchStats());
+        }
+
+        // Every member ran out of budget, unless they were called off
+        return this->budget.stop_token.stop_requested() ?
+                   SearchStatus::CANCELLED :
+                   SearchStatus::BUDGET_EXHAUSTED;
+    }
+
+    this->step_count = heuristics[this->winner]->getStepCount();
+    this->solution_count = heuristics[this->winner]->getSolutionCount();
+    this->stats.reset();
+    this->stats.merge(heuristics[this->winner]->getSearchStats());
+    if (status == SearchStatus::SOLVED) {
+        this->board.setValues(boards[this->winner].getValues());
+    }
+
+    return status;
+}
+
+std::string_view PortfolioHeuristic::getWinner() const {
+    if (this->winner == this->members.size()) {
+        return {};
+    }
+    return this->members[this->winner].name;
+}
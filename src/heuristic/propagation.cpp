@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <bit>
+#include <span>
+
+#include "engine/combinations.h"
+#include "heuristic/propagation.h"
+
+using sudoku_engine::BoardCellMask;
+using sudoku_engine::CageCombinations;
+using sudoku_engine::PropagationHeuristic;
+using sudoku_engine::toCellRangeMask;
+
+static constexpr BoardCellMask ALL_VALUES =
+    (1u << (sudoku_engine::CELL_MAX - sudoku_engine::CELL_MIN + 1)) - 1;
+
+static sudoku_engine::BoardCell lowestValue(BoardCellMask mask) {
+    return static_cast<sudoku_engine::BoardCell>(
+        sudoku_engine::CELL_MIN + std::countr_zero(mask)
+    );
+}
+
+static sudoku_engine::BoardCell highestValue(BoardCellMask mask) {
+    return static_cast<sudoku_engine::BoardCell>(
+        sudoku_engine::CELL_MIN + std::bit_width(mask) - 1
+    );
+}
+
+// Cages are only enumerated exactly when the product of their domain sizes
+// stays under this, larger ones fall back to the sum bounds
+static constexpr std::size_t EXACT_SUPPORT_LIMIT = 4096;
+
+// Marks in support every value that appears in some assignment of values
+// from domains[index..] adding up to sum, which are distinct unless used is
+// left out of the recursion
+static bool collectSupport(
+    std::span<const BoardCellMask> domains,
+    std::span<BoardCellMask> support,
+    std::span<BoardCellMask> chosen,
+    std::size_t index,
+    int sum,
+    BoardCellMask used,
+    bool distinct
+) {
+    if (index == domains.size()) {
+        if (sum != 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < domains.size(); i++) {
+            support[i] |= chosen[i];
+        }
+        return true;
+    }
+
+    bool found = false;
+    const auto options = static_cast<BoardCellMask>(
+        domains[index] & ~used &
+        sudoku_engine::toCellRangeMask(sudoku_engine::CELL_MIN, sum)
+    );
+    for (BoardCellMask rest = options; rest != 0; rest &= rest - 1) {
+        const auto value_mask = static_cast<BoardCellMask>(rest & (~rest + 1));
+        chosen[index] = value_mask;
+        found |= collectSupport(
+            domains,
+            support,
+            chosen,
+            index + 1,
+            sum - lowestValue(value_mask),
+            distinct ? static_cast<BoardCellMask>(used | value_mask) : used,
+            distinct
+        );
+    }
+
+    return found;
+}
+
+PropagationHeuristic::PropagationHeuristic(
+    Board& board,
+    std::size_t step_limit,
+    ValueOrder value_order,
+    RestartPolicy restarts
+)
+    : ForwardHeuristic(board, step_limit, true, value_order, restarts) {}
+
+bool PropagationHeuristic::applyValue(
+    const BoardPosition& pos,
+    BoardCell value
+) {
+    const std::size_t trail_mark = this->trail.size();
+
+    if (!ForwardHeuristic::applyValue(pos, value)) {
+        return false;
+    }
+
+    return this->propagate(trail_mark);
+}
+
+bool PropagationHeuristic::propagate(std::size_t trail_mark) {
+    this->unit_queue_size = 0;
+    this->is_queued.reset();
+
+    const auto& cell_values = this->board.getValues();
+    const auto cages = this->board.getCages();
+    const auto derived_sums = this->board.getDerivedSums();
+
+    std::size_t trail_head = trail_mark;
+
+    while (true) {
+        // Every trail entry past the mark is a cell whose domain shrank
+        while (trail_head < this->trail.size()) {
+            const BoardPosition pos = this->trail.data()[trail_head++].pos;
+            const BoardCellMask domain = this->cell_domains[pos].toMask();
+
+            if (domain == 0) {
+                return false;
+            }
+            if (cell_values[pos] != CELL_EMPTY) {
+                continue;
+            }
+
+            this->queueUnits(pos);
+
+            // Naked single
+            if (std::has_single_bit(domain) &&
+                !this->eliminateSingle(pos, lowestValue(domain))) {
+                return false;
+            }
+        }
+
+        if (this->unit_queue_size == 0) {
+            return true;
+        }
+
+        const std::size_t unit = this->unit_queue[--this->unit_queue_size];
+        this->is_queued[unit] = false;
+
+        const auto index = static_cast<BoardOffset>(unit % BOARD_SIZE);
+
+        bool is_legal;
+        if (unit < BOARD_SIZE) {
+            is_legal = this->checkHouse(this->board.getRow(index));
+        } else if (unit < 2 * BOARD_SIZE) {
+            is_legal = this->checkHouse(this->board.getCol(index));
+        } else if (unit < HOUSE_COUNT) {
+            is_legal = this->checkHouse(this->board.getBox(index));
+        } else if (unit < DERIVED_UNIT_START) {
+            const auto& cage = cages[unit - HOUSE_COUNT];
+            is_legal = this->tightenSum(
+                cage.cells, cage.sum, this->board.getCageState(cage), true
+            );
+        } else {
+            const std::size_t derived = unit - DERIVED_UNIT_START;
+            is_legal = this->tightenSum(
+                derived_sums[derived].cells,
+                derived_sums[derived].sum,
+                this->board.getDerivedState(derived),
+                derived_sums[derived].distinct
+            );
+        }
+
+        if (!is_legal) {
+            return false;
+        }
+    }
+}
+
+void PropagationHeuristic::queueUnit(std::size_t unit) {
+    if (!this->is_queued[unit]) {
+        this->is_queued[unit] = true;
+        this->unit_queue[this->unit_queue_size++] =
+            static_cast<std::uint16_t>(unit);
+    }
+}
+
+void PropagationHeuristic::queueUnits(const BoardPosition& pos) {
+    this->queueUnit(pos.row);
+    this->queueUnit(BOARD_SIZE + pos.col);
+    this->queueUnit(2 * BOARD_SIZE + this->board.getCellBox(pos));
+
+    if (const auto cage = this->board.getCellCage(pos); cage != nullptr) {
+        this->queueUnit(HOUSE_COUNT + this->board.getCageIndex(*cage));
+    }
+
+    for (const auto index : this->board.getCellDerivedSums(pos)) {
+        this->queueUnit(DERIVED_UNIT_START + index);
+    }
+}
+
+bool PropagationHeuristic::eliminateSingle(
+    const BoardPosition& pos,
+    BoardCell value
+) {
+    const auto others = static_cast<BoardCellMask>(~toCellMask(value));
+
+    for (const auto& p : this->board.getPeers(pos)) {
+        if (!this->narrowDomain(p, others)) {
+            return false;
+        }
+    }
+
+    if (const auto cage = this->board.getCellCage(pos); cage != nullptr) {
+        for (const auto& p : cage->cells) {
+            if (p != pos && !this->narrowDomain(p, others)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool PropagationHeuristic::checkHouse(const Board::LineOrBox& cells) {
+    // Values seen in at least one cell, and in at least two cells
+    BoardCellMask once = 0;
+    BoardCellMask twice = 0;
+
+    for (const auto& p : cells) {
+        const BoardCellMask domain = this->cell_domains[p].toMask();
+        twice |= once & domain;
+        once |= domain;
+    }
+
+    // Every value has to go somewhere in the house
+    if (once != ALL_VALUES) {
+        return false;
+    }
+
+    // Hidden singles
+    BoardCellMask singles = once & ~twice;
+    for (const auto& p : cells) {
+        if (singles == 0) {
+            break;
+        }
+
+        const auto hidden = static_cast<BoardCellMask>(
+            this->cell_domains[p].toMask() & singles
+        );
+        if (hidden == 0) {
+            continue;
+        }
+
+        // Two values that only fit in this one cell
+        if (!std::has_single_bit(hidden)) {
+            return false;
+        }
+
+        this->narrowDomain(p, hidden);
+        singles &= ~hidden;
+    }
+
+    return true;
+}
+
+bool PropagationHeuristic::tightenSum(
+    std::span<const BoardPosition> sum_cells,
+    unsigned target,
+    const Board::CageState& state,
+    bool distinct
+) {
+    if (state.sum > target) {
+        return false;
+    }
+
+    const unsigned remaining = target - state.sum;
+    const unsigned empty_count = state.empty_count;
+    if (empty_count == 0) {
+        return remaining == 0;
+    }
+
+    // Sums that may repeat values only get the bounds below
+    const BoardCellMask allowed = distinct ?
+        CageCombinations::candidates(remaining, empty_count, state.used) :
+        ALL_VALUES;
+    if (allowed == 0) {
+        return false;
+    }
+
+    const auto& cell_values = this->board.getValues();
+
+    std::array<BoardPosition, BOARD_SIZE> cells;
+    std::array<BoardCellMask, BOARD_SIZE> domains;
+    std::size_t cell_count = 0;
+
+    int min_total = 0;
+    int max_total = 0;
+    for (const auto& p : sum_cells) {
+        if (cell_values[p] != CELL_EMPTY) {
+            continue;
+        }
+
+        const auto domain = static_cast<BoardCellMask>(
+            this->cell_domains[p].toMask() & allowed
+        );
+        if (domain == 0) {
+            return false;
+        }
+
+        cells[cell_count] = p;
+        domains[cell_count] = domain;
+        cell_count++;
+
+        min_total += lowestValue(domain);
+        max_total += highestValue(domain);
+    }
+
+    // Each cell has to leave a sum the other cells can still reach
+    for (std::size_t i = 0; i < cell_count; i++) {
+        const int others_min = min_total - lowestValue(domains[i]);
+        const int others_max = max_total - highestValue(domains[i]);
+        domains[i] &= toCellRangeMask(
+            int(remaining) - others_max, int(remaining) - others_min
+        );
+
+        if (!this->narrowDomain(cells[i], domains[i])) {
+            return false;
+        }
+    }
+
+    // Small enough to keep only the values of actual combinations
+    std::size_t combination_bound = 1;
+    for (std::size_t i = 0; i < cell_count; i++) {
+        combination_bound *= std::popcount(domains[i]);
+    }
+
+    if (combination_bound <= EXACT_SUPPORT_LIMIT) {
+        std::array<BoardCellMask, BOARD_SIZE> support = {};
+        std::array<BoardCellMask, BOARD_SIZE> chosen = {};
+
+        const auto domain_span = std::span(domains).first(cell_count);
+        if (!collectSupport(
+                domain_span,
+                support,
+                chosen,
+                0,
+                int(remaining),
+                distinct ? state.used : BoardCellMask(0),
+                distinct
+            )) {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < cell_count; i++) {
+            domains[i] = support[i];
+            this->narrowDomain(cells[i], domains[i]);
+        }
+    }
+
+    if (!distinct) {
+        return true;
+    }
+
+    // Hidden singles for values that are part of every combination
+    for (BoardCellMask rest = allowed; rest != 0; rest &= rest - 1) {
+        const auto value_mask = static_cast<BoardCellMask>(rest & (~rest + 1));
+        const auto without_value = static_cast<BoardCellMask>(
+            state.used | value_mask
+        );
+        if (CageCombinations::candidates(
+                remaining, empty_count, without_value
+            ) != 0) {
+            continue;
+        }
+
+        std::size_t holder = cell_count;
+        for (std::size_t i = 0; i < cell_count; i++) {
+            if (domains[i] & value_mask) {
+                if (holder != cell_count) {
+                    holder = cell_count + 1;
+                    break;
+                }
+                holder = i;
+            }
+        }
+
+        if (holder == cell_count) {
+            return false;
+        }
+        if (holder < cell_count) {
+            this->narrowDomain(cells[holder], value_mask);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "heuristic/trace.h"
+
+using sudoku_engine::BoardCellDomain;
+using sudoku_engine::BoardPosition;
+using sudoku_engine::SearchTrace;
+using sudoku_engine::TraceEvent;
+using sudoku_engine::TraceEventType;
+using sudoku_engine::TraceRecorder;
+using sudoku_engine::TraceReplayer;
+
+// "KST1" when read as little-endian bytes
+static constexpr std::uint32_t TRACE_MAGIC = 0x3154534B;
+static constexpr std::uint8_t TRACE_VERSION = 1;
+// Magic, version, 3 reserved bytes, event count and dropped count
+static constexpr std::size_t TRACE_HEADER_SIZE = 24;
+
+static constexpr std::size_t CELL_COUNT =
+    std::size_t(sudoku_engine::BOARD_SIZE) * sudoku_engine::BOARD_SIZE;
+
+static BoardPosition toPosition(std::size_t offset) {
+    return {
+        static_cast<sudoku_engine::BoardOffset>(
+            offset / sudoku_engine::BOARD_SIZE
+        ),
+        static_cast<sudoku_engine::BoardOffset>(
+            offset % sudoku_engine::BOARD_SIZE
+        )
+    };
+}
+
+TraceRecorder::TraceRecorder(std::size_t capacity)
+    : events(std::make_unique<TraceEvent[]>(
+          std::bit_ceil(std::max<std::size_t>(capacity, 1))
+      )),
+      capacity(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+      initial_values(BOARD_SIZE, CELL_EMPTY),
+      initial_domains(BOARD_SIZE, ~BoardCellDomain()) {}
+
+void TraceRecorder::begin(
+    const BoardState<BoardCell>& values,
+    const BoardState<BoardCellDomain>& domains
+) {
+    this->recorded_count = 0;
+    this->initial_values = values;
+    this->initial_domains = domains;
+}
+
+SearchTrace TraceRecorder::getTrace() const {
+    SearchTrace trace;
+    trace.initial_values = this->initial_values;
+    trace.initial_domains = this->initial_domains;
+
+    const std::uint64_t held =
+        std::min<std::uint64_t>(this->recorded_count, this->capacity);
+    trace.dropped_count = this->recorded_count - held;
+
+    trace.events.reserve(held);
+    for (std::uint64_t i = trace.dropped_count; i < this->recorded_count;
+         i++) {
+        trace.events.push_back(this->events[i & (this->capacity - 1)]);
+    }
+    return trace;
+}
+
+void SearchTrace::save(std::ostream& output) const {
+    std::uint8_t header[TRACE_HEADER_SIZE] = {};
+    std::memcpy(header, &TRACE_MAGIC, 4);
+    header[4] = TRACE_VERSION;
+    const std::uint64_t event_count = this->events.size();
+    std::memcpy(header + 8, &event_count, 8);
+    std::memcpy(header + 16, &this->dropped_count, 8);
+    output.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // Values, then domain masks, in row-major order
+    for (std::size_t i = 0; i < CELL_COUNT; i++) {
+        output.put(static_cast<char>(this->initial_values[toPosition(i)]));
+    }
+    for (std::size_t i = 0; i < CELL_COUNT; i++) {
+        const BoardCellMask mask =
+            this->initial_domains[toPosition(i)].toMask();
+        output.write(reinterpret_cast<const char*>(&mask), sizeof(mask));
+    }
+
+    output.write(
+        reinterpret_cast<const char*>(this->events.data()),
+        static_cast<std::streamsize>(
+            this->events.size() * sizeof(TraceEvent)
+        )
+    );
+    if (!output)
+        throw std::runtime_error("Failed to write trace");
+}
+
+SearchTrace SearchTrace::load(std::istream& input) {
+    std::uint8_t header[TRACE_HEADER_SIZE];
+    input.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!input)
+        throw std::runtime_error("Failed to read trace header");
+
+    std::uint32_t magic;
+    std::memcpy(&magic, header, 4);
+    if (magic != TRACE_MAGIC)
+        throw std::runtime_error("Not a search trace");
+    if (header[4] != TRACE_VERSION)
+        throw std::runtime_error("Unsupported search trace version");
+
+    SearchTrace trace;
+    std::uint64_t event_count;
+    std::memcpy(&event_count, header + 8, 8);
+    std::memcpy(&trace.dropped_count, header + 16, 8);
+
+    for (std::size_t i = 0; i < CELL_COUNT; i++) {
+        const int value = input.get();
+        if (value < CELL_EMPTY || value > CELL_MAX)
+            throw std::runtime_error("Invalid value in trace");
+        trace.initial_values[toPosition(i)] = static_cast<BoardCell>(value);
+    }
+    for (std::size_t i = 0; i < CELL_COUNT; i++) {
+        BoardCellMask mask;
+        input.read(reinterpret_cast<char*>(&mask), sizeof(mask));
+        trace.initial_domains[toPosition(i)] =
+            BoardCellDomain::fromMask(mask);
+    }
+    if (!input)
+        throw std::runtime_error("Failed to read trace board");
+
+    // Read in chunks, so a corrupt count fails on the data rather than on
+    // one huge allocation
+    constexpr std::size_t CHUNK_EVENTS = 1 << 16;
+    while (trace.events.size() < event_count) {
+        const std::size_t start = trace.events.size();
+        const auto chunk = static_cast<std::size_t>(
+            std::min<std::uint64_t>(CHUNK_EVENTS, event_count - start)
+        );
+        trace.events.resize(start + chunk);
+        input.read(
+            reinterpret_cast<char*>(trace.events.data() + start),
+            static_cast<std::streamsize>(chunk * sizeof(TraceEvent))
+        );
+        if (!input)
+            throw std::runtime_error("Trace ended early");
+    }
+
+    for (const TraceEvent& event : trace.events) {
+        if (event.type > TraceEventType::MRV_PICK ||
+            event.cell >= CELL_COUNT)
+            throw std::runtime_error("Invalid event in trace");
+    }
+    return trace;
+}
+
+// e.g. "r1c5" for the fifth cell of the first row
+static std::string getCellName(std::size_t offset) {
+    const BoardPosition pos = toPosition(offset);
+    return 'r' + std::to_string(pos.row + 1) + 'c' +
+           std::to_string(pos.col + 1);
+}
+
+// e.g. "1359"
+static std::string getDomainName(sudoku_engine::BoardCellMask mask) {
+    using sudoku_engine::BoardCell;
+
+    std::string name;
+    for (BoardCell value = sudoku_engine::CELL_MIN;
+         value <= sudoku_engine::CELL_MAX;
+         value++) {
+        if ((mask & sudoku_engine::toCellMask(value)) != 0) {
+            name += char('0' + value);
+        }
+    }
+    return name;
+}
+
+void SearchTrace::writeChromeTrace(std::ostream& output) const {
+    // A wrapped trace can start inside assignments, whose ends are left out
+    std::size_t depth = 0;
+    bool first = true;
+
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const auto begin_event = [&](std::size_t ts, std::string_view phase) {
+        output << (first ? "\n" : ",\n") << "{\"ph\":\"" << phase
+               << "\",\"pid\":1,\"tid\":1,\"ts\":" << ts;
+        first = false;
+    };
+    const auto write_depth = [&](std::size_t ts) {
+        begin_event(ts, "C");
+        output << ",\"name\":\"depth\",\"args\":{\"depth\":" << depth
+               << "}}";
+    };
+
+    for (std::size_t ts = 0; ts < this->events.size(); ts++) {
+        const TraceEvent& event = this->events[ts];
+        const std::string cell = getCellName(event.cell);
+
+        switch (event.type) {
+            case TraceEventType::ASSIGN:
+                depth++;
+                begin_event(ts, "B");
+                output << ",\"name\":\"" << cell << '=' << int(event.value)
+                       << "\",\"cat\":\"assign\"}";
+                write_depth(ts);
+                break;
+            case TraceEventType::UNASSIGN:
+                if (depth == 0) {
+                    break;
+                }
+                depth--;
+                begin_event(ts, "E");
+                output << '}';
+                write_depth(ts);
+                break;
+            case TraceEventType::PRUNE:
+                begin_event(ts, "i");
+                output << ",\"s\":\"t\",\"name\":\"prune " << cell
+                       << "\",\"cat\":\"prune\",\"args\":{\"from\":\""
+                       << getDomainName(event.old_domain) << "\",\"to\":\""
+                       << getDomainName(event.new_domain) << "\"}}";
+                break;
+            case TraceEventType::BACKTRACK:
+                begin_event(ts, "i");
+                output << ",\"s\":\"t\",\"name\":\"backtrack " << cell
+                       << "\",\"cat\":\"backtrack\"}";
+                break;
+            case TraceEventType::MRV_PICK:
+                begin_event(ts, "i");
+                output << ",\"s\":\"t\",\"name\":\"mrv " << cell
+                       << "\",\"cat\":\"mrv\",\"args\":{\"domain_size\":"
+                       << int(event.value) << "}}";
+                break;
+        }
+    }
+
+    // Close what the search left assigned, i.e. the solution
+    while (depth > 0) {
+        depth--;
+        begin_event(this->events.size(), "E");
+        output << '}';
+    }
+    output << "\n]}\n";
+}
+
+TraceReplayer::TraceReplayer(const SearchTrace& trace)
+    : trace(trace), values(trace.initial_values),
+      domains(trace.initial_domains) {
+    if (trace.dropped_count > 0) {
+        throw std::runtime_error(
+            "Trace lost its first " + std::to_string(trace.dropped_count) +
+            " events, record it with a larger capacity to replay it"
+        );
+    }
+}
+
+void TraceReplayer::restart() {
+    this->values = this->trace.initial_values;
+    this->domains = this->trace.initial_domains;
+    this->assignments.clear();
+    this->prunes.clear();
+    this->position = 0;
+}
+
+void TraceReplayer::step() {
+    if (this->isDone()) {
+        return;
+    }
+
+    const TraceEvent& event = this->trace.events[this->position];
+    const BoardPosition pos = toPosition(event.cell);
+
+    switch (event.type) {
+        case TraceEventType::ASSIGN:
+            if (this->values[pos] != CELL_EMPTY) {
+                throw std::runtime_error(
+                    "Trace assigns filled cell " + getCellName(event.cell)
+                );
+            }
+            this->assignments.push_back({pos, this->prunes.size()});
+            this->values[pos] = event.value;
+            break;
+
+        case TraceEventType::UNASSIGN:
+            if (this->assignments.empty() ||
+                !(this->assignments.back().pos == pos)) {
+                throw std::runtime_error(
+                    "Trace unassigns " + getCellName(event.cell) +
+                    " out of order"
+                );
+            }
+            for (std::size_t i = this->prunes.size();
+                 i > this->assignments.back().prune_mark;
+                 i--) {
+                const Prune& prune = this->prunes[i - 1];
+                this->domains[prune.pos] = prune.domain;
+            }
+            this->prunes.resize(this->assignments.back().prune_mark);
+            this->assignments.pop_back();
+            this->values[pos] = CELL_EMPTY;
+            break;
+
+        case TraceEventType::PRUNE:
+            if (this->domains[pos].toMask() != event.old_domain) {
+                throw std::runtime_error(
+                    "Trace prunes " + getCellName(event.cell) +
+                    " from a domain it doesn't have"
+                );
+            }
+            this->prunes.push_back({pos, this->domains[pos]});
+            this->domains[pos] = BoardCellDomain::fromMask(event.new_domain);
+            break;
+
+        case TraceEventType::BACKTRACK:
+        case TraceEventType::MRV_PICK:
+            break;
+    }
+
+    this->position++;
+}
+
+void TraceReplayer::seek(std::size_t position) {
+    position = std::min(position, this->trace.events.size());
+    if (position < this->position) {
+        this->restart();
+    }
+    while (this->position < position) {
+        this->step();
+    }
+}
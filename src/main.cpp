@@ -1,24 +1,73 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <ctime>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
+#include "benchmark.h"
+#include "bundles.h"
 #include "engine/solver.h"
 #include "heuristic/backtrack.h"
+#include "heuristic/dlx.h"
 #include "heuristic/forward.h"
+#include "heuristic/parallel.h"
+#include "heuristic/portfolio.h"
+#include "heuristic/propagation.h"
+#include "perf.h"
+#include "prefetch.h"
+#include "replay.h"
 #include "serialization.h"
 
+using sudoku_engine::utils::getSeconds;
+using sudoku_engine::utils::Timer;
+
 struct Options {
     using HeuristicFactory = std::function<std::unique_ptr<
-        sudoku_engine::BacktrackHeuristic>(sudoku_engine::Board& board)>;
+        sudoku_engine::Heuristic>(sudoku_engine::Board& board)>;
 
-    std::unique_ptr<std::ifstream> puzzle_file;
-    sudoku_engine::serialization::PuzzleLoader puzzle_loader;
+    // Shared by every thread, each reads its puzzles straight out of it
+    std::unique_ptr<sudoku_engine::serialization::MappedPuzzleLoader>
+        puzzle_loader;
+    // Set instead of the loader when reading standard input, threads take
+    // turns reading the next puzzle
+    std::unique_ptr<sudoku_engine::serialization::PuzzleStreamReader>
+        puzzle_stream;
     HeuristicFactory heuristic;
     std::string heuristic_name;
     long puzzle_index;
+    // Threads searching each puzzle, in which case times are wall clock
+    std::size_t thread_count;
+    // Threads solving separate puzzles of the bundle at once
+    std::size_t batch_thread_count;
+    // Puzzles decoded ahead of the solving threads
+    std::size_t prefetch_depth;
+    // The data files then also record which member won each puzzle
+    bool is_portfolio;
+    // Wall clock time allowed per puzzle, on top of the step limit
+    std::optional<std::chrono::milliseconds> time_limit;
+    // Count solutions up to this many instead of checking the one found
+    std::optional<std::size_t> solution_limit;
+    // Read hardware counters around every solve, where the kernel allows
+    bool perf_counters;
+    // Where to write the search trace of a single puzzle, if anywhere
+    std::optional<std::string> trace_filename;
+    // Set along with the file, every heuristic made records into it
+    std::unique_ptr<sudoku_engine::TraceRecorder> trace_recorder;
 };
 
 static void printHelp(std::string_view exe_path) {
@@ -30,25 +79,268 @@ static void printHelp(std::string_view exe_path) {
     std::cout << "Usage: " << exe_name
               << " [puzzle_bundle_file.ks[:puzzle_index]]"
               << " [step_limit]"
-              << " [forward [mrv | lcv | mrv lcv] | backtrack]" << std::endl;
+              << " [forward [mrv] [lcv | alcv] [luby | geometric] |"
+              << " propagate [lcv | alcv] [luby | geometric] |"
+              << " backtrack | dlx | portfolio [member,...]]"
+              << " [--parallel thread_count]"
+              << " [--threads thread_count] [--time-limit milliseconds]"
+              << " [--seed number] [--count solution_limit]"
+              << " [--prefetch depth] [--perf-counters]"
+              << " [--trace trace_file.kst] [--trace-capacity event_count]"
+              << std::endl;
+    std::cout << "       " << exe_name
+              << " --generate output_bundle_file.ks puzzle_count"
+              << " max_cage_size [--threads thread_count] [--seed number]"
+              << " [--merges merge_attempts] [--format 1 | 2 | text]"
+              << std::endl;
+    std::cout << "       " << exe_name
+              << " --convert input_bundle_file.ks output_bundle_file.ks"
+              << " [--format 1 | 2 | text]" << std::endl;
+    std::cout << "       " << exe_name
+              << " --benchmark bundle_file.ks[,...] heuristic[,...]"
+              << " [--step-limit step_limit] [--warmup puzzle_count]"
+              << " [--repeat pass_count] [--puzzles puzzle_count]"
+              << " [--output results.csv] [--baseline results.csv]"
+              << " [--max-regression percent]"
+              << " [--max-step-regression percent]" << std::endl;
+    std::cout << "       " << exe_name
+              << " --replay trace_file.kst [--step event_index]"
+              << " [--chrome trace.json]" << std::endl;
+    std::cout << "A bundle file of \"-\" reads KSF1 or text from standard"
+              << " input, and writes KSF2 or text to standard output."
+              << std::endl;
+}
+
+// Parses the value of --format, returns nullopt if there's no such format
+static std::optional<sudoku_engine::serialization::BundleFormat>
+parseBundleFormat(std::string_view value) {
+    using sudoku_engine::serialization::BundleFormat;
+
+    if (value == "1") {
+        return BundleFormat::KSF1;
+    }
+    if (value == "2") {
+        return BundleFormat::KSF2;
+    }
+    if (value == "text") {
+        return BundleFormat::TEXT;
+    }
+    std::cout << "Unknown bundle format \"" << value
+              << "\", expected 1, 2 or text" << std::endl;
+    return std::nullopt;
+}
+
+// Opens the file a bundle is written to, or standard output for "-".
+// Returns nullptr, having said why, if the bundle can't go there.
+static std::ostream* openBundleOutput(
+    const std::string& filename,
+    sudoku_engine::serialization::BundleFormat format,
+    std::ofstream& file
+) {
+    if (filename == "-") {
+        if (format == sudoku_engine::serialization::BundleFormat::KSF1) {
+            std::cerr << "KSF1 bundles can't be written to a pipe, use"
+                      << " --format 2 or --format text" << std::endl;
+            return nullptr;
+        }
+        return &std::cout;
+    }
+
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Could not open \"" << filename << "\" for writing!"
+                  << std::endl;
+        return nullptr;
+    }
+    return &file;
+}
+
+// A heuristic and its variant, named the way the data files are, e.g.
+// "forward-mrv-lcv" or "forward-mrv-luby"
+struct HeuristicConfig {
+    // Only set for backtracking searches, which can also run in parallel
+    sudoku_engine::ParallelHeuristic::Factory search;
+    Options::HeuristicFactory heuristic;
+};
+
+static constexpr std::string_view DEFAULT_PORTFOLIO =
+    "backtrack,forward,forward-mrv,forward-mrv-lcv";
+
+static std::optional<HeuristicConfig> parseHeuristic(
+    std::string_view name,
+    std::size_t step_limit,
+    std::uint64_t seed
+) {
+    using sudoku_engine::BacktrackHeuristic;
+    using sudoku_engine::Board;
+    using sudoku_engine::DlxHeuristic;
+    using sudoku_engine::ForwardHeuristic;
+    using sudoku_engine::PropagationHeuristic;
+    using SearchPtr = std::unique_ptr<BacktrackHeuristic>;
+    using ValueOrder = ForwardHeuristic::ValueOrder;
+    using RestartSchedule = ForwardHeuristic::RestartSchedule;
+
+    const std::size_t dash = name.find('-');
+    const std::string_view strategy = name.substr(0, dash);
+    std::string_view variant =
+        dash == name.npos ? std::string_view() : name.substr(dash + 1);
+
+    // Variant words have to come in this order
+    const auto take_word = [&](std::string_view word) {
+        const bool is_next = variant.substr(0, variant.find('-')) == word;
+        if (is_next) {
+            variant.remove_prefix(std::min(variant.size(), word.size() + 1));
+        }
+        return is_next;
+    };
+
+    HeuristicConfig config;
+
+    if (strategy == "forward" || strategy == "propagate") {
+        const bool mrv = strategy == "forward" && take_word("mrv");
+
+        ValueOrder value_order = ValueOrder::NATURAL;
+        if (take_word("lcv")) {
+            value_order = ValueOrder::LCV;
+        } else if (take_word("alcv")) {
+            value_order = ValueOrder::APPROX_LCV;
+        }
+
+        ForwardHeuristic::RestartPolicy restarts;
+        restarts.seed = seed;
+        if (take_word("luby")) {
+            restarts.schedule = RestartSchedule::LUBY;
+        } else if (take_word("geometric")) {
+            restarts.schedule = RestartSchedule::GEOMETRIC;
+        }
+
+        if (strategy == "forward") {
+            config.search = [=](Board& board) -> SearchPtr {
+                return std::make_unique<ForwardHeuristic>(
+                    board, step_limit, mrv, value_order, restarts
+                );
+            };
+        } else {
+            config.search = [=](Board& board) -> SearchPtr {
+                return std::make_unique<PropagationHeuristic>(
+                    board, step_limit, value_order, restarts
+                );
+            };
+        }
+    } else if (strategy == "backtrack") {
+        config.search = [step_limit](Board& board) -> SearchPtr {
+            return std::make_unique<BacktrackHeuristic>(board, step_limit);
+        };
+    } else if (strategy == "dlx") {
+        config.heuristic = [step_limit](Board& board) {
+            return std::make_unique<DlxHeuristic>(board, step_limit);
+        };
+    } else {
+        return std::nullopt;
+    }
+
+    if (!variant.empty()) {
+        return std::nullopt;
+    }
+
+    if (config.search) {
+        config.heuristic = config.search;
+    }
+    return config;
 }
 
 static std::unique_ptr<Options> parseOptions(
     const int argc,
     const char* const argv[]
 ) {
-    using sudoku_engine::BacktrackHeuristic;
     using sudoku_engine::Board;
-    using sudoku_engine::ForwardHeuristic;
     using sudoku_engine::Heuristic;
+    using sudoku_engine::ParallelHeuristic;
+    using sudoku_engine::PortfolioHeuristic;
 
-    const std::string_view args[] = {
-        (argc > 1) ? argv[1] : "",
-        (argc > 2) ? argv[2] : "",
-        (argc > 3) ? argv[3] : "",
-        (argc > 4) ? argv[4] : "",
-        (argc > 5) ? argv[5] : "",
-    };
+    // Flags may appear anywhere, everything else is positional
+    std::vector<std::string_view> positional;
+    std::size_t thread_count = 1;
+    std::size_t batch_thread_count = 1;
+    std::size_t prefetch_depth = 64;
+    std::optional<std::chrono::milliseconds> time_limit;
+    // Randomized restarts are the same from run to run with the same seed
+    std::uint64_t seed = 0;
+    std::optional<std::size_t> solution_limit;
+    bool perf_counters = false;
+    std::optional<std::string> trace_filename;
+    std::size_t trace_capacity = std::size_t(1) << 20;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--time-limit") {
+            if (i + 1 >= argc) {
+                std::cout << "Time limit required" << std::endl;
+                return nullptr;
+            }
+            time_limit = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--seed") {
+            if (i + 1 >= argc) {
+                std::cout << "Seed required" << std::endl;
+                return nullptr;
+            }
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--count") {
+            if (i + 1 >= argc) {
+                std::cout << "Solution limit required" << std::endl;
+                return nullptr;
+            }
+
+            solution_limit = std::stoull(argv[++i]);
+            if (*solution_limit == 0) {
+                std::cout << "Solution limit must be positive" << std::endl;
+                return nullptr;
+            }
+        } else if (arg == "--parallel" || arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cout << "Thread count required" << std::endl;
+                return nullptr;
+            }
+
+            const std::size_t count = std::stoull(argv[++i]);
+            if (count == 0) {
+                std::cout << "Thread count must be positive" << std::endl;
+                return nullptr;
+            }
+            (arg == "--parallel" ? thread_count : batch_thread_count) = count;
+        } else if (arg == "--prefetch") {
+            if (i + 1 >= argc) {
+                std::cout << "Prefetch depth required" << std::endl;
+                return nullptr;
+            }
+
+            prefetch_depth = std::stoull(argv[++i]);
+            if (prefetch_depth == 0) {
+                std::cout << "Prefetch depth must be positive" << std::endl;
+                return nullptr;
+            }
+        } else if (arg == "--perf-counters") {
+            perf_counters = true;
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cout << "Trace file required" << std::endl;
+                return nullptr;
+            }
+            trace_filename = argv[++i];
+        } else if (arg == "--trace-capacity") {
+            if (i + 1 >= argc) {
+                std::cout << "Trace capacity required" << std::endl;
+                return nullptr;
+            }
+            trace_capacity = std::stoull(argv[++i]);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    std::string_view args[5];
+    for (std::size_t i = 0; i < std::size(args) && i < positional.size(); i++) {
+        args[i] = positional[i];
+    }
 
     if (args[0] == "" || args[0] == "--help") {
         printHelp(argv[0]);
@@ -67,27 +359,48 @@ static std::unique_ptr<Options> parseOptions(
             puzzle_str.substr(puzzle_index_pos + 1) :
             std::string_view();
 
-    auto puzzle_file =
-        std::make_unique<std::ifstream>(filename, std::ios::binary);
-    if (!puzzle_file->is_open()) {
-        std::cout << "Failed to open file \"" << filename << "\"!";
+    using sudoku_engine::serialization::MappedPuzzleLoader;
+    using sudoku_engine::serialization::PuzzleStreamReader;
+
+    const bool is_stream = filename == "-";
+    if (is_stream && !puzzle_index_str.empty()) {
+        std::cout << "Puzzle index can't be used with standard input"
+                  << std::endl;
         return nullptr;
     }
 
     auto options = std::unique_ptr<Options>(new Options{
-        .puzzle_file = nullptr,
-        .puzzle_loader =
-            sudoku_engine::serialization::PuzzleLoader(*puzzle_file),
+        .puzzle_loader = is_stream ?
+                             nullptr :
+                             std::make_unique<MappedPuzzleLoader>(filename),
+        .puzzle_stream = is_stream ?
+                             std::make_unique<PuzzleStreamReader>(std::cin) :
+                             nullptr,
         .heuristic = nullptr,
         .heuristic_name = std::string(),
         .puzzle_index = puzzle_index_str.empty() ?
                             -1 :
-                            std::stol(std::string(puzzle_index_str))
+                            std::stol(std::string(puzzle_index_str)),
+        .thread_count = thread_count,
+        .batch_thread_count = batch_thread_count,
+        .prefetch_depth = prefetch_depth,
+        .is_portfolio = false,
+        .time_limit = time_limit,
+        .solution_limit = solution_limit,
+        .perf_counters = perf_counters,
+        .trace_filename = trace_filename,
+        .trace_recorder = nullptr
     });
 
-    options->puzzle_file = std::move(puzzle_file);
     options->heuristic_name = strategy;
 
+    if (options->puzzle_loader &&
+        options->puzzle_index >=
+            long(options->puzzle_loader->puzzle_count())) {
+        std::cout << "Puzzle index out of range" << std::endl;
+        return nullptr;
+    }
+
     if (step_limit_str.empty()) {
         std::cout << "Step limit required" << std::endl;
         return nullptr;
@@ -95,46 +408,361 @@ static std::unique_ptr<Options> parseOptions(
 
     const std::size_t step_limit = std::stoull(std::string(step_limit_str));
 
-    using HeuristicPtr = std::unique_ptr<BacktrackHeuristic>;
-    if (strategy == "forward") {
-        constexpr std::size_t bp = std::size(args) - 2;
+    using HeuristicPtr = std::unique_ptr<Heuristic>;
+
+    if (strategy == "portfolio") {
+        if (thread_count > 1) {
+            std::cout << "portfolio can't run in parallel" << std::endl;
+            return nullptr;
+        }
+        if (trace_filename) {
+            std::cout << "portfolio can't be traced" << std::endl;
+            return nullptr;
+        }
+
+        // Comma separated member names, e.g. "forward-mrv,propagate"
+        std::string_view member_names = args[3].empty() ?
+                                            DEFAULT_PORTFOLIO :
+                                            args[3];
+
+        std::vector<PortfolioHeuristic::Member> members;
+        while (!member_names.empty()) {
+            const std::size_t comma = member_names.find(',');
+            const std::string_view name = member_names.substr(0, comma);
+            member_names = comma == member_names.npos ?
+                               std::string_view() :
+                               member_names.substr(comma + 1);
 
-        const bool mrv = args[bp] == "mrv";
-        const bool lcv = args[bp] == "lcv" || (mrv && args[bp + 1] == "lcv");
+            const auto config = parseHeuristic(name, step_limit, seed);
+            if (!config) {
+                std::cout << "Invalid portfolio member: \"" << name << '"'
+                          << std::endl;
+                return nullptr;
+            }
+            members.push_back({std::string(name), config->heuristic});
+        }
 
         options->heuristic = [=](Board& board) -> HeuristicPtr {
-            return std::make_unique<ForwardHeuristic>(
-                board, step_limit, mrv, lcv
+            return std::make_unique<PortfolioHeuristic>(
+                board, step_limit, members
             );
         };
+        options->is_portfolio = true;
+        return options;
+    }
 
-        if (mrv)
-            options->heuristic_name += "-mrv";
-        if (lcv)
-            options->heuristic_name += "-lcv";
-    } else if (strategy == "backtrack") {
-        options->heuristic = [step_limit](Board& board) -> HeuristicPtr {
-            return std::make_unique<BacktrackHeuristic>(board, step_limit);
+    // Trailing words name the variant, e.g. "forward mrv lcv"
+    for (std::size_t i = 3; i < std::size(args) && !args[i].empty(); i++) {
+        options->heuristic_name += '-';
+        options->heuristic_name += args[i];
+    }
+
+    const auto config =
+        parseHeuristic(options->heuristic_name, step_limit, seed);
+    if (!config) {
+        std::cout << "Invalid heuristic: \"" << options->heuristic_name << '"'
+                  << std::endl;
+        return nullptr;
+    }
+
+    if (thread_count > 1) {
+        if (!config->search) {
+            std::cout << strategy << " can't run in parallel" << std::endl;
+            return nullptr;
+        }
+
+        const ParallelHeuristic::Factory search = config->search;
+        options->heuristic = [=](Board& board) -> HeuristicPtr {
+            return std::make_unique<ParallelHeuristic>(
+                board, step_limit, thread_count, search
+            );
         };
+        options->heuristic_name += "-p" + std::to_string(thread_count);
     } else {
-        std::cout << "Invalid heuristic: \"" << strategy << '"' << std::endl;
-        return nullptr;
+        options->heuristic = config->heuristic;
+    }
+
+    if (trace_filename) {
+        if (options->puzzle_index < 0) {
+            std::cout << "Only a single puzzle can be traced" << std::endl;
+            return nullptr;
+        }
+
+        // Only the backtracking searches record traces, and only on a
+        // single thread
+        if (!config->search || thread_count > 1) {
+            std::cout << options->heuristic_name << " can't be traced"
+                      << std::endl;
+            return nullptr;
+        }
+
+        options->trace_recorder =
+            std::make_unique<sudoku_engine::TraceRecorder>(trace_capacity);
+        sudoku_engine::TraceRecorder* const recorder =
+            options->trace_recorder.get();
+        const ParallelHeuristic::Factory search = config->search;
+        options->heuristic = [=](Board& board) -> HeuristicPtr {
+            auto heuristic = search(board);
+            heuristic->setTraceRecorder(recorder);
+            return heuristic;
+        };
     }
 
     return options;
 }
 
-static void solvePuzzles(Options& options) {
-    using sudoku_engine::BacktrackHeuristic;
-    using sudoku_engine::Board;
+// Outcome of one puzzle in a batch
+struct PuzzleResult {
+    // Output for the puzzle, printed once every earlier puzzle is reported
+    std::string log;
+    bool solved = false;
+    // The solver is broken, the batch stops at this puzzle
+    bool failed = false;
+    double time = 0;
+    std::size_t steps = 0;
+    // Portfolio member that solved the puzzle
+    std::string winner;
+    // Only counted with a solution limit, in which case solutions is a
+    // lower bound unless the search ran out of places to look
+    std::size_t solutions = 0;
+    bool exact_solutions = false;
+    // Only counted when built with SUDOKU_SEARCH_STATS
+    sudoku_engine::SearchStats stats;
+    // Only read with --perf-counters
+    sudoku_engine::PerfSample counters;
+};
+
+static constexpr bool HAS_SEARCH_STATS =
+    sudoku_engine::SearchStatsPolicy::ENABLED;
+
+static void writeSearchStatsHeader(std::ostream& output) {
+    output << ",Nodes,Backtracks,Forward Checks,Failed Forward Checks"
+           << ",Values Pruned,Max Depth";
+    for (std::size_t size = 0; size <= sudoku_engine::BOARD_SIZE; size++) {
+        output << ",MRV " << size;
+    }
+    output << ",Select Time,Order Time,Propagate Time";
+}
+
+static void writeSearchStats(
+    std::ostream& output,
+    const sudoku_engine::SearchStats& stats
+) {
+    output << ',' << stats.nodes << ',' << stats.backtracks << ','
+           << stats.forward_checks << ',' << stats.failed_forward_checks
+           << ',' << stats.values_pruned << ',' << stats.max_depth;
+    for (const std::size_t count : stats.mrv_histogram) {
+        output << ',' << count;
+    }
+    for (const double seconds : stats.phase_seconds) {
+        output << ',' << seconds;
+    }
+}
+
+static PuzzleResult solvePuzzle(
+    std::span<const sudoku_engine::BoardCage> cages,
+    const sudoku_engine::BoardState<sudoku_engine::BoardCell>& solution,
+    unsigned long index,
+    sudoku_engine::Board& board,
+    sudoku_engine::Heuristic& heuristic,
+    std::optional<std::chrono::milliseconds> time_limit,
+    std::optional<std::size_t> solution_limit,
+    bool single_puzzle,
+    Timer timer,
+    sudoku_engine::PerfCounters* counters,
+    std::ostream& log
+) {
+    using sudoku_engine::PortfolioHeuristic;
+    using sudoku_engine::SearchBudget;
+    using sudoku_engine::SearchStatus;
     using sudoku_engine::Solver;
-    using sudoku_engine::serialization::PuzzleLoader;
 
     Solver solver;
+    PuzzleResult result;
+
+    // The cages go first, the old ones may be gone already
+    board.setCages(cages);
+    board.clearValues();
+
+    if (single_puzzle) {
+        log << std::endl << "Initial Board:" << std::endl;
+        board.print(log);
+
+        log << std::endl << "Solving..." << std::endl;
+    }
+
+    heuristic.reset();
 
-    PuzzleLoader& puzzle_loader = options.puzzle_loader;
+    if (time_limit || solution_limit) {
+        SearchBudget budget = heuristic.getBudget();
+        if (time_limit) {
+            budget.deadline = SearchBudget::Clock::now() + *time_limit;
+        }
+        budget.solution_limit = solution_limit.value_or(1);
+        heuristic.setBudget(budget);
+    }
+
+    // Solve the puzzle
+    if (counters != nullptr) {
+        counters->start();
+    }
+    const double solving_start = getSeconds(timer);
+    const SearchStatus status = solver.solve(heuristic);
+    const double solving_end = getSeconds(timer);
+    if (counters != nullptr) {
+        result.counters = counters->stop();
+    }
+
+    if (status == SearchStatus::BUDGET_EXHAUSTED) {
+        log << "  - The solver rage-quit puzzle #" << index << "."
+            << std::endl;
+        return result;
+    } else if (status == SearchStatus::CANCELLED) {
+        log << "  - The solver was cancelled on puzzle #" << index << "."
+            << std::endl;
+        return result;
+    }
+
+    // Any solution will do when counting, the board isn't checked
+    if (solution_limit) {
+        result.solutions = heuristic.getSolutionCount();
+        result.exact_solutions = status == SearchStatus::UNSATISFIABLE;
+
+        if (result.solutions == 0) {
+            log << std::endl
+                << "[FAIL] No solution exists for puzzle #" << index << "!"
+                << std::endl;
+            result.failed = true;
+            return result;
+        }
+
+        if (single_puzzle) {
+            log << std::endl
+                << "[DONE] Found "
+                << (result.exact_solutions ? "" : "at least ")
+                << result.solutions << " solution(s)." << std::endl;
+        } else if (result.solutions > 1) {
+            log << "  - Puzzle #" << index << " has more than one solution."
+                << std::endl;
+        }
+
+        result.solved = true;
+        result.time = solving_end - solving_start;
+        result.steps = heuristic.getStepCount();
+        result.stats = heuristic.getSearchStats();
+        return result;
+    }
+
+    if (status == SearchStatus::SOLVED) {
+        if (board.getValues() == solution) {
+            if (single_puzzle) {
+                log << std::endl << "[DONE] Solution found!" << std::endl;
+            }
+        } else {
+            const bool valid = !board.isIncomplete() && !board.isInvalid();
+
+            if (!valid || single_puzzle) {
+                log << std::endl << "[WARN] Solution mismatch!" << std::endl;
+
+                log << "Received:" << std::endl;
+                board.print(log);
+
+                log << "Expected:" << std::endl;
+                board.setValues(solution);
+                board.print(log);
+            }
+
+            if (!valid) {
+                log << "[FAIL] Solution is also invalid!" << std::endl;
+                result.failed = true;
+                return result;
+            } else if (single_puzzle) {
+                log << "[INFO] Alternative solution found." << std::endl;
+            }
+        }
+    } else {
+        log << std::endl
+            << "[FAIL] No solution exists for puzzle #" << index << "!"
+            << std::endl;
+        board.print(log);
+        result.failed = true;
+        return result;
+    }
+
+    if (single_puzzle) {
+        board.print(log);
+    }
+
+    result.solved = true;
+    result.time = solving_end - solving_start;
+    result.steps = heuristic.getStepCount();
+    result.stats = heuristic.getSearchStats();
+
+    if (const auto portfolio = dynamic_cast<PortfolioHeuristic*>(&heuristic)) {
+        result.winner = portfolio->getWinner();
+        if (single_puzzle) {
+            log << "[INFO] Won by " << result.winner << "." << std::endl;
+        }
+    }
+
+    return result;
+}
+
+static void writePerfCountersHeader(std::ostream& output) {
+    for (std::size_t i = 0; i < sudoku_engine::PERF_COUNTER_COUNT; i++) {
+        output << ','
+               << sudoku_engine::getPerfCounterName(
+                      sudoku_engine::PerfCounter(i)
+                  );
+    }
+}
+
+// Counters that couldn't be read are left empty
+static void writePerfSample(
+    std::ostream& output,
+    const sudoku_engine::PerfSample& sample
+) {
+    for (const auto& count : sample.counts) {
+        output << ',';
+        if (count) {
+            output << *count;
+        }
+    }
+}
+
+static void solvePuzzles(Options& options) {
+    using sudoku_engine::Board;
+    using sudoku_engine::BoardCage;
+    using sudoku_engine::BoardCell;
+    using sudoku_engine::BoardState;
+    using sudoku_engine::PrefetchedPuzzle;
+    using sudoku_engine::PrefetchStats;
+    using sudoku_engine::PuzzlePrefetcher;
+    using sudoku_engine::serialization::MappedPuzzleLoader;
+    using sudoku_engine::serialization::PuzzleStreamReader;
+
+    const MappedPuzzleLoader* const puzzle_loader = options.puzzle_loader.get();
+    PuzzleStreamReader* const puzzle_stream = options.puzzle_stream.get();
 
     const bool single_puzzle = options.puzzle_index >= 0;
+    const Timer timer = options.thread_count > 1 || options.is_portfolio ?
+                            Timer::WALL_CLOCK :
+                            Timer::THREAD_CPU;
+
+    // Opened once up front to see whether the kernel allows it, each thread
+    // then opens its own
+    if (options.perf_counters) {
+        const sudoku_engine::PerfCounters probe;
+        if (!probe.isAvailable()) {
+            std::cout << "[WARN] Hardware counters unavailable ("
+                      << probe.getError() << "), running without them."
+                      << std::endl;
+            options.perf_counters = false;
+        } else if (!probe.getError().empty()) {
+            std::cout << "[WARN] Some hardware counters unavailable ("
+                      << probe.getError() << ")." << std::endl;
+        }
+    }
 
     std::ofstream data_output;
 
@@ -153,103 +781,231 @@ static void solvePuzzles(Options& options) {
             std::cout << "Writing to \"" << filename << "\"..." << std::endl;
         }
 
-        data_output << "Puzzle,Time,Steps" << std::endl;
+        data_output << "Puzzle,Time,Steps";
+        if (options.is_portfolio) {
+            data_output << ",Winner";
+        }
+        if (options.solution_limit) {
+            data_output << ",Solutions";
+        }
+        if (HAS_SEARCH_STATS) {
+            writeSearchStatsHeader(data_output);
+        }
+        if (options.perf_counters) {
+            writePerfCountersHeader(data_output);
+        }
+        data_output << std::endl;
     }
 
     const unsigned long index_start = single_puzzle ? options.puzzle_index : 0;
-    const unsigned long index_end =
-        single_puzzle ? options.puzzle_index + 1 : puzzle_loader.puzzle_count();
-    const unsigned long index_range = index_end - index_start;
+    // Not known for a stream until it ends
+    unsigned long index_end = single_puzzle ? options.puzzle_index + 1 :
+                              puzzle_loader ? puzzle_loader->puzzle_count() :
+                                              0;
 
     long double total_cpu_time = 0;
     size_t total_steps_taken = 0;
     unsigned long puzzle_count = 0;
+    // For the tail of the distribution, which restarts are meant to cut
+    std::vector<std::size_t> step_counts;
+    std::map<std::string, unsigned long> win_counts;
+    unsigned long unique_count = 0;
+    sudoku_engine::SearchStats total_stats;
+    // Totals over the puzzles each counter was read for, and how many
+    std::array<std::uint64_t, sudoku_engine::PERF_COUNTER_COUNT>
+        total_counts = {};
+    std::array<unsigned long, sudoku_engine::PERF_COUNTER_COUNT>
+        counted_puzzles = {};
 
-    for (unsigned long index = index_start; index < index_end; index++) {
-        const auto puzzle = puzzle_loader.load_puzzle(index);
-        Board board;
+    // Threads take puzzles in index order, but results are reported in that
+    // order too, so the output and the totals match a serial run
+    std::mutex report_mutex;
+    // Results from next_report on, held back by a puzzle still being solved
+    std::deque<std::optional<PuzzleResult>> pending_results;
+    unsigned long next_report = 0;
+    std::atomic<bool> failed = false;
 
-        board.setCages(puzzle->cages.data());
+    const auto report = [&](const PuzzleResult& result, unsigned long index) {
+        std::cout << result.log;
+        if (!result.solved) {
+            return;
+        }
 
-        if (single_puzzle) {
-            std::cout << std::endl << "Initial Board:" << std::endl;
-            board.print(std::cout);
+        if (!single_puzzle && puzzle_count % 100 == 0) {
+            std::cout << "  > [" << puzzle_count;
+            if (puzzle_loader) {
+                std::cout << "/" << index_end - index_start;
+            }
+            std::cout << "]" << std::endl;
+        }
 
-            std::cout << std::endl << "Solving..." << std::endl;
+        if (!single_puzzle) {
+            data_output << index << ',' << result.time << ',' << result.steps;
+            if (options.is_portfolio) {
+                data_output << ',' << result.winner;
+            }
+            if (options.solution_limit) {
+                data_output << ',' << result.solutions;
+            }
+            if (HAS_SEARCH_STATS) {
+                writeSearchStats(data_output, result.stats);
+            }
+            if (options.perf_counters) {
+                writePerfSample(data_output, result.counters);
+            }
+            data_output << '\n';
         }
 
-        const auto heuristic = options.heuristic(board);
+        if (options.is_portfolio) {
+            win_counts[result.winner]++;
+        }
+        if (result.exact_solutions && result.solutions == 1) {
+            unique_count++;
+        }
+
+        total_stats.merge(result.stats);
+        for (std::size_t i = 0; i < total_counts.size(); i++) {
+            if (const auto& count = result.counters.counts[i]) {
+                total_counts[i] += *count;
+                counted_puzzles[i]++;
+            }
+        }
+        total_cpu_time += result.time;
+        total_steps_taken += result.steps;
+        step_counts.push_back(result.steps);
+        puzzle_count++;
+    };
 
-        bool solution_found = false;
+    // Puzzles are read and decoded ahead on a thread of their own
+    unsigned long next_index = index_start;
+    PuzzlePrefetcher prefetcher(
+        options.prefetch_depth,
+        [&](std::vector<BoardCage>& cages, BoardState<BoardCell>& solution) {
+            if (puzzle_stream) {
+                return puzzle_stream->read_puzzle(cages, solution);
+            }
+            if (next_index >= index_end) {
+                return false;
+            }
 
-        // Solve the puzzle
-        std::clock_t solving_start = std::clock();
-        try {
-            solution_found = solver.solve(*heuristic);
-        } catch (const BacktrackHeuristic::TooHardError& err) {
-            std::cout << "  - The solver rage-quit puzzle #" << index << "."
-                      << std::endl;
-            continue;
+            const auto puzzle = puzzle_loader->view_puzzle(next_index++);
+            puzzle.decode_cages(cages);
+            puzzle.decode_solution(solution);
+            return true;
         }
-        std::clock_t solving_end = std::clock();
+    );
 
-        if (solution_found) {
-            if (board.getValues() == puzzle->solution) {
-                if (single_puzzle) {
-                    std::cout << std::endl
-                              << "[DONE] Solution found!" << std::endl;
-                }
-            } else {
-                const bool valid = !board.isIncomplete() && !board.isInvalid();
+    // Each thread keeps one board and heuristic for all of its puzzles
+    const auto run_worker = [&]() {
+        Board board;
+        const auto heuristic = options.heuristic(board);
+        std::optional<sudoku_engine::PerfCounters> counters;
+        if (options.perf_counters) {
+            counters.emplace();
+        }
+        // Swapped with the prefetcher's, so storage goes around in a loop
+        PrefetchedPuzzle puzzle;
+        std::ostringstream buffer;
+        // A single thread can print as it goes
+        std::ostream& log =
+            options.batch_thread_count > 1 ? buffer : std::cout;
 
-                if (!valid || single_puzzle) {
-                    std::cout << std::endl
-                              << "[WARN] Solution mismatch!" << std::endl;
+        while (!failed && prefetcher.take(puzzle)) {
+            const unsigned long index = index_start + puzzle.index;
 
-                    std::cout << "Received:" << std::endl;
-                    board.print(std::cout);
+            PuzzleResult result = solvePuzzle(
+                puzzle.cages,
+                puzzle.solution,
+                index,
+                board,
+                *heuristic,
+                options.time_limit,
+                options.solution_limit,
+                single_puzzle,
+                timer,
+                counters ? &*counters : nullptr,
+                log
+            );
+            result.log = buffer.str();
+            buffer.str("");
 
-                    std::cout << "Expected:" << std::endl;
-                    board.setValues(puzzle->solution);
-                    board.print(std::cout);
-                }
+            std::lock_guard lock(report_mutex);
+            const unsigned long slot = index - index_start - next_report;
+            if (pending_results.size() <= slot) {
+                pending_results.resize(slot + 1);
+            }
+            pending_results[slot] = std::move(result);
 
-                if (!valid) {
-                    std::cout << "[FAIL] Solution is also invalid!"
-                              << std::endl;
-                    break;
-                } else if (single_puzzle) {
-                    std::cout << "[INFO] Alternative solution found."
-                              << std::endl;
+            while (!failed && !pending_results.empty() &&
+                   pending_results.front()) {
+                const PuzzleResult& next = *pending_results.front();
+                report(next, index_start + next_report);
+                if (next.failed) {
+                    failed = true;
+                    prefetcher.stop();
                 }
+                pending_results.pop_front();
+                next_report++;
             }
-        } else {
-            std::cout << std::endl
-                      << "[FAIL] No solution exists for puzzle #" << index
-                      << "!" << std::endl;
-            board.print(std::cout);
-            break;
         }
+    };
 
-        if (single_puzzle) {
-            board.print(std::cout);
-        } else if (puzzle_count % 100 == 0) {
-            std::cout << "  > [" << puzzle_count << "/" << index_range << "]"
-                      << std::endl;
+    // A worker that throws stops the others, and the first error is
+    // rethrown once they've all returned, as on a single thread
+    std::exception_ptr worker_error;
+    const auto run_thread = [&]() {
+        try {
+            run_worker();
+        } catch (...) {
+            std::lock_guard lock(report_mutex);
+            if (!worker_error) {
+                worker_error = std::current_exception();
+            }
+            failed = true;
+            prefetcher.stop();
         }
+    };
 
-        const auto cpu_time_taken =
-            (solving_end - solving_start) / static_cast<double>(CLOCKS_PER_SEC);
-        const auto step_count = heuristic->getStepCount();
+    if (options.batch_thread_count > 1) {
+        {
+            std::vector<std::jthread> threads;
+            for (std::size_t i = 0; i < options.batch_thread_count; i++) {
+                threads.emplace_back(run_thread);
+            }
+        }
+        if (worker_error) {
+            std::rethrow_exception(worker_error);
+        }
+    } else {
+        run_worker();
+    }
 
-        if (!single_puzzle) {
-            data_output << index << ',' << cpu_time_taken << ',' << step_count
-                        << std::endl;
+    prefetcher.finish();
+    const PrefetchStats prefetch_stats = prefetcher.getStats();
+    if (puzzle_stream) {
+        index_end = index_start + prefetch_stats.taken;
+    }
+    const unsigned long index_range = index_end - index_start;
+
+    if (options.trace_recorder) {
+        const sudoku_engine::SearchTrace trace =
+            options.trace_recorder->getTrace();
+        std::ofstream trace_output(*options.trace_filename, std::ios::binary);
+        if (!trace_output.is_open()) {
+            throw std::runtime_error(
+                "Could not open \"" + *options.trace_filename + '"'
+            );
         }
+        trace.save(trace_output);
 
-        total_cpu_time += cpu_time_taken;
-        total_steps_taken += step_count;
-        puzzle_count++;
+        std::cout << "[INFO] Wrote " << trace.events.size()
+                  << " trace events to \"" << *options.trace_filename
+                  << "\"." << std::endl;
+        if (trace.dropped_count > 0) {
+            std::cout << "[WARN] The first " << trace.dropped_count
+                      << " events were overwritten, raise --trace-capacity"
+                      << " to replay the trace." << std::endl;
+        }
     }
 
     const auto avg_cpu_time = total_cpu_time / puzzle_count;
@@ -259,16 +1015,440 @@ static void solvePuzzles(Options& options) {
     std::cout << std::endl;
     std::cout << "Puzzles Solved:      " << puzzle_count << " / " << index_range
               << std::endl;
-    std::cout << "Avg. CPU Time Taken: " << avg_cpu_time << " seconds"
-              << std::endl;
+    std::cout << (timer == Timer::WALL_CLOCK ? "Avg. Wall Time:      " :
+                                               "Avg. CPU Time Taken: ")
+              << avg_cpu_time << " seconds" << std::endl;
     std::cout << "Avg. Steps Taken:    " << avg_step_count << std::endl;
+
+    if (!step_counts.empty()) {
+        std::sort(step_counts.begin(), step_counts.end());
+        const std::size_t p99_rank = (step_counts.size() * 99 + 99) / 100;
+        std::cout << "P99 Steps Taken:     " << step_counts[p99_rank - 1]
+                  << std::endl;
+        std::cout << "Max Steps Taken:     " << step_counts.back()
+                  << std::endl;
+    }
+
+    if (options.solution_limit) {
+        std::cout << "Unique Puzzles:      " << unique_count << " / "
+                  << puzzle_count << std::endl;
+    }
+
+    for (const auto& [member, wins] : win_counts) {
+        std::cout << "Wins by " << member << ": " << wins << std::endl;
+    }
+
+    if (HAS_SEARCH_STATS && puzzle_count > 0) {
+        const auto average = [&](std::size_t total) {
+            return total / static_cast<double>(puzzle_count);
+        };
+        const auto& phases = total_stats.phase_seconds;
+        const double phase_total = phases[0] + phases[1] + phases[2];
+        const auto share = [&](sudoku_engine::SearchPhase phase) {
+            const double seconds = phases[std::size_t(phase)];
+            return phase_total > 0 ? seconds / phase_total * 100 : 0;
+        };
+
+        std::cout << "Avg. Nodes:          " << average(total_stats.nodes)
+                  << std::endl;
+        std::cout << "Avg. Backtracks:     "
+                  << average(total_stats.backtracks) << std::endl;
+        std::cout << "Avg. Forward Checks: "
+                  << average(total_stats.forward_checks) << " ("
+                  << average(total_stats.failed_forward_checks)
+                  << " failed)" << std::endl;
+        std::cout << "Avg. Values Pruned:  "
+                  << average(total_stats.values_pruned) << std::endl;
+        std::cout << "Max Search Depth:    " << total_stats.max_depth
+                  << std::endl;
+
+        // Neither is recorded by every heuristic
+        const auto& histogram = total_stats.mrv_histogram;
+        if (std::any_of(histogram.begin(), histogram.end(), [](auto count) {
+                return count > 0;
+            })) {
+            std::cout << "MRV Domain Sizes:   ";
+            for (std::size_t size = 0; size < histogram.size(); size++) {
+                if (histogram[size] > 0) {
+                    std::cout << ' ' << size << ':' << histogram[size];
+                }
+            }
+            std::cout << std::endl;
+        }
+
+        if (phase_total > 0) {
+            using sudoku_engine::SearchPhase;
+            std::cout << "Phase Time Split:    select "
+                      << share(SearchPhase::SELECT) << "%, order "
+                      << share(SearchPhase::ORDER) << "%, propagate "
+                      << share(SearchPhase::PROPAGATE) << '%' << std::endl;
+        }
+    }
+
+    if (options.perf_counters) {
+        using sudoku_engine::PerfCounter;
+
+        for (std::size_t i = 0; i < total_counts.size(); i++) {
+            if (counted_puzzles[i] == 0) {
+                continue;
+            }
+
+            const std::string label =
+                "Avg. " +
+                std::string(sudoku_engine::getPerfCounterName(PerfCounter(i))) +
+                ":";
+            std::cout << std::left << std::setw(21) << label << std::right
+                      << total_counts[i] /
+                             static_cast<double>(counted_puzzles[i])
+                      << std::endl;
+        }
+
+        // Ratios are only fair over the same puzzles
+        const auto ratio = [&](PerfCounter a, PerfCounter b, double scale) {
+            const auto i = std::size_t(a);
+            const auto j = std::size_t(b);
+            if (counted_puzzles[i] == 0 ||
+                counted_puzzles[i] != counted_puzzles[j] ||
+                total_counts[j] == 0) {
+                return std::optional<double>();
+            }
+            return std::optional<double>(
+                total_counts[i] * scale / total_counts[j]
+            );
+        };
+
+        if (const auto ipc = ratio(
+                PerfCounter::INSTRUCTIONS, PerfCounter::CYCLES, 1
+            )) {
+            std::cout << "Instructions/Cycle:  " << *ipc << std::endl;
+        }
+        if (const auto mpki = ratio(
+                PerfCounter::BRANCH_MISSES, PerfCounter::INSTRUCTIONS, 1000
+            )) {
+            std::cout << "Branch MPKI:         " << *mpki << std::endl;
+        }
+        if (const auto mpki = ratio(
+                PerfCounter::LLC_MISSES, PerfCounter::INSTRUCTIONS, 1000
+            )) {
+            std::cout << "LLC MPKI:            " << *mpki << std::endl;
+        }
+    }
+
+    // Solvers waiting on the ring means the run is bound by reading, the
+    // reader waiting on them means it's bound by solving
+    if (!single_puzzle && prefetch_stats.taken > 0) {
+        std::cout << "Prefetch Depth:      " << prefetch_stats.depth
+                  << std::endl;
+        std::cout << "Avg. Ready Puzzles:  "
+                  << prefetch_stats.ready_total /
+                         static_cast<double>(prefetch_stats.taken)
+                  << std::endl;
+        std::cout << "Solver Stalls:       " << prefetch_stats.solver_stalls
+                  << " / " << prefetch_stats.taken << std::endl;
+        std::cout << "Reader Stalls:       " << prefetch_stats.reader_stalls
+                  << std::endl;
+    }
+}
+
+// Writes a bundle of new unique puzzles, returns the exit code
+static int generatePuzzles(const int argc, const char* const argv[]) {
+    sudoku_engine::BundleGeneratorOptions options;
+    std::vector<std::string_view> positional;
+    auto format = sudoku_engine::serialization::BundleFormat::KSF1;
+    for (int i = 2; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if ((arg == "--threads" || arg == "--seed" || arg == "--merges" ||
+             arg == "--format") &&
+            i + 1 >= argc) {
+            std::cout << "Value required for " << arg << std::endl;
+            return 1;
+        } else if (arg == "--threads") {
+            options.thread_count = std::stoull(argv[++i]);
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--merges") {
+            options.generator.merge_attempts = std::stoull(argv[++i]);
+        } else if (arg == "--format") {
+            const auto parsed = parseBundleFormat(argv[++i]);
+            if (!parsed) {
+                return 1;
+            }
+            format = *parsed;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 3) {
+        printHelp(argv[0]);
+        return 1;
+    }
+
+    const std::string filename = std::string(positional[0]);
+    options.puzzle_count =
+        static_cast<std::uint32_t>(std::stoul(std::string(positional[1])));
+
+    options.generator.max_cage_size = std::stoull(std::string(positional[2]));
+    if (options.generator.max_cage_size < 1 ||
+        options.generator.max_cage_size > sudoku_engine::BOARD_SIZE) {
+        std::cout << "Cage size must be between 1 and "
+                  << sudoku_engine::BOARD_SIZE << std::endl;
+        return 1;
+    }
+    if (options.thread_count == 0) {
+        std::cout << "Thread count must be positive" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    std::ostream* const output = openBundleOutput(filename, format, file);
+    if (output == nullptr) {
+        return 1;
+    }
+    // Kept out of the way of a bundle going down a pipe
+    std::ostream& log = output == &std::cout ? std::cerr : std::cout;
+
+    log << "Generating " << options.puzzle_count << " puzzles into \""
+        << filename << "\"..." << std::endl;
+    sudoku_engine::generateBundle(options, *output, format, log);
+    return 0;
+}
+
+// Rewrites a bundle in the other format, returns the exit code
+static int convertPuzzles(const int argc, const char* const argv[]) {
+    using sudoku_engine::serialization::BundleFormat;
+    using sudoku_engine::serialization::MappedPuzzleLoader;
+
+    std::vector<std::string_view> positional;
+    auto format = BundleFormat::KSF2;
+    for (int i = 2; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--format" && i + 1 >= argc) {
+            std::cout << "Value required for " << arg << std::endl;
+            return 1;
+        } else if (arg == "--format") {
+            const auto parsed = parseBundleFormat(argv[++i]);
+            if (!parsed) {
+                return 1;
+            }
+            format = *parsed;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2) {
+        printHelp(argv[0]);
+        return 1;
+    }
+
+    const MappedPuzzleLoader loader{std::string(positional[0])};
+
+    const std::string filename = std::string(positional[1]);
+    std::ofstream file;
+    std::ostream* const output = openBundleOutput(filename, format, file);
+    if (output == nullptr) {
+        return 1;
+    }
+    std::ostream& log = output == &std::cout ? std::cerr : std::cout;
+
+    log << "Converting " << loader.puzzle_count() << " puzzles into \""
+        << filename << "\"..." << std::endl;
+    sudoku_engine::convertBundle(loader, *output, format);
+    log << "Done." << std::endl;
+    return 0;
+}
+
+// Runs every bundle with every heuristic and checks the results against a
+// baseline, returns the exit code, 2 if anything regressed
+static int benchmarkPuzzles(const int argc, const char* const argv[]) {
+    using sudoku_engine::BenchmarkHeuristic;
+    using sudoku_engine::BenchmarkOptions;
+    using sudoku_engine::BenchmarkResult;
+
+    BenchmarkOptions options;
+    std::vector<std::string_view> positional;
+    std::optional<std::string> baseline_filename;
+    std::optional<std::string> output_filename;
+
+    for (int i = 2; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const bool takes_value =
+            arg == "--step-limit" || arg == "--warmup" || arg == "--repeat" ||
+            arg == "--puzzles" || arg == "--baseline" || arg == "--output" ||
+            arg == "--max-regression" || arg == "--max-step-regression";
+        if (takes_value && i + 1 >= argc) {
+            std::cout << "Value required for " << arg << std::endl;
+            return 1;
+        } else if (arg == "--step-limit") {
+            options.step_limit = std::stoull(argv[++i]);
+        } else if (arg == "--warmup") {
+            options.warmup_count = std::stoull(argv[++i]);
+        } else if (arg == "--repeat") {
+            options.repeat_count = std::stoull(argv[++i]);
+        } else if (arg == "--puzzles") {
+            options.puzzle_limit = std::stoull(argv[++i]);
+        } else if (arg == "--baseline") {
+            baseline_filename = argv[++i];
+        } else if (arg == "--output") {
+            output_filename = argv[++i];
+        } else if (arg == "--max-regression") {
+            options.max_time_regression = std::stod(argv[++i]);
+        } else if (arg == "--max-step-regression") {
+            options.max_step_regression = std::stod(argv[++i]);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2) {
+        printHelp(argv[0]);
+        return 1;
+    }
+    if (options.repeat_count == 0) {
+        std::cout << "Repeat count must be positive" << std::endl;
+        return 1;
+    }
+
+    // Comma separated, e.g. "a.ks,b.ks" and "forward-mrv,propagate"
+    const auto split = [](std::string_view list) {
+        std::vector<std::string> items;
+        while (!list.empty()) {
+            const std::size_t comma = list.find(',');
+            items.emplace_back(list.substr(0, comma));
+            list = comma == list.npos ? std::string_view() :
+                                        list.substr(comma + 1);
+        }
+        return items;
+    };
+    const std::vector<std::string> bundles = split(positional[0]);
+
+    std::vector<BenchmarkHeuristic> heuristics;
+    for (const std::string& name : split(positional[1])) {
+        const auto config = parseHeuristic(name, options.step_limit, 0);
+        if (!config) {
+            std::cout << "Invalid heuristic: \"" << name << '"' << std::endl;
+            return 1;
+        }
+        heuristics.push_back({name, config->heuristic});
+    }
+
+    // Read first, so a missing baseline doesn't waste a whole run
+    std::vector<BenchmarkResult> baseline;
+    if (baseline_filename) {
+        std::ifstream input(*baseline_filename);
+        if (!input.is_open()) {
+            std::cout << "Could not open \"" << *baseline_filename << '"'
+                      << std::endl;
+            return 1;
+        }
+        baseline = sudoku_engine::readBenchmarkResults(input);
+    }
+
+    const std::vector<BenchmarkResult> results =
+        sudoku_engine::runBenchmarks(bundles, heuristics, options, std::cout);
+
+    if (output_filename) {
+        std::ofstream output(*output_filename);
+        sudoku_engine::writeBenchmarkResults(output, results);
+        if (!output) {
+            std::cout << "Could not write \"" << *output_filename << '"'
+                      << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote \"" << *output_filename << "\"." << std::endl;
+    }
+
+    if (!baseline_filename) {
+        return 0;
+    }
+
+    std::cout << std::endl;
+    if (sudoku_engine::compareBenchmarkResults(
+            results, baseline, options, std::cout
+        )) {
+        return 2;
+    }
+    std::cout << "[DONE] No regressions against \"" << *baseline_filename
+              << "\"." << std::endl;
+    return 0;
+}
+
+// Replays a trace file, returns the exit code
+static int replayTraceFile(const int argc, const char* const argv[]) {
+    std::optional<std::string> trace_filename;
+    std::optional<std::size_t> step;
+    std::optional<std::string> chrome_filename;
+
+    for (int i = 2; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if ((arg == "--step" || arg == "--chrome") && i + 1 >= argc) {
+            std::cout << "Value required for " << arg << std::endl;
+            return 1;
+        } else if (arg == "--step") {
+            step = std::stoull(argv[++i]);
+        } else if (arg == "--chrome") {
+            chrome_filename = argv[++i];
+        } else if (!trace_filename) {
+            trace_filename = arg;
+        } else {
+            printHelp(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!trace_filename) {
+        printHelp(argv[0]);
+        return 1;
+    }
+
+    return sudoku_engine::replayTrace(
+        *trace_filename, step, chrome_filename, std::cout
+    );
 }
 
 int main(int argc, char* argv[]) {
     using sudoku_engine::Solver;
 
-    std::cout << "Killer Sudoku Solver v0.1.0" << std::endl;
-    std::cout << "===========================" << std::endl;
+    // Lets a bundle streamed from standard input be read as it arrives
+    // rather than a byte at a time
+    std::ios::sync_with_stdio(false);
+
+    const bool writes_bundle =
+        argc > 1 && (std::string_view(argv[1]) == "--generate" ||
+                     std::string_view(argv[1]) == "--convert");
+    // A bundle written to standard output goes down a pipe, so everything
+    // else goes to standard error
+    const bool bundle_to_stdout =
+        writes_bundle &&
+        std::find(argv + 2, argv + argc, std::string_view("-")) != argv + argc;
+    std::ostream& log = bundle_to_stdout ? std::cerr : std::cout;
+
+    log << "Killer Sudoku Solver v0.1.0" << std::endl;
+    log << "===========================" << std::endl;
+
+    if (writes_bundle) {
+        try {
+            return std::string_view(argv[1]) == "--generate" ?
+                       generatePuzzles(argc, argv) :
+                       convertPuzzles(argc, argv);
+        } catch (const std::exception& err) {
+            log << "[ERROR] " << err.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (argc > 1 && (std::string_view(argv[1]) == "--benchmark" ||
+                     std::string_view(argv[1]) == "--replay")) {
+        try {
+            return std::string_view(argv[1]) == "--benchmark" ?
+                       benchmarkPuzzles(argc, argv) :
+                       replayTraceFile(argc, argv);
+        } catch (const std::exception& err) {
+            std::cout << "[ERROR] " << err.what() << std::endl;
+            return 1;
+        }
+    }
 
     std::unique_ptr<Options> options;
     try {
@@ -281,7 +1461,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    solvePuzzles(*options);
+    try {
+        solvePuzzles(*options);
+    } catch (const std::exception& err) {
+        std::cout << "[ERROR] " << err.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,171 @@
+#include "perf.h"
+
+// Emscripten claims to be Unix, but has no perf events
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SUDOKU_HAS_PERF_EVENTS 1
+#else
+#define SUDOKU_HAS_PERF_EVENTS 0
+#endif
+
+using sudoku_engine::PerfCounter;
+using sudoku_engine::PerfCounters;
+using sudoku_engine::PerfSample;
+
+std::string_view sudoku_engine::getPerfCounterName(PerfCounter counter) {
+    switch (counter) {
+        case PerfCounter::CYCLES:
+            return "Cycles";
+        case PerfCounter::INSTRUCTIONS:
+            return "Instructions";
+        case PerfCounter::BRANCH_MISSES:
+            return "Branch Misses";
+        case PerfCounter::L1D_MISSES:
+            return "L1D Misses";
+        case PerfCounter::LLC_MISSES:
+            return "LLC Misses";
+    }
+    return {};
+}
+
+#if SUDOKU_HAS_PERF_EVENTS
+
+// Type and config of each PerfCounter, in order
+static perf_event_attr getPerfEventAttr(PerfCounter counter) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+
+    switch (counter) {
+        case PerfCounter::CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounter::INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounter::BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PerfCounter::L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfCounter::LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+    }
+
+    // Only the solver's own code, started and stopped around each solve.
+    // Parallel searches start their threads inside the solve, so those
+    // are counted too.
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return attr;
+}
+
+PerfCounters::PerfCounters() {
+    for (std::size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perf_event_attr attr = getPerfEventAttr(PerfCounter(i));
+
+        // The calling thread, on whichever CPU it runs
+        this->fds[i] = static_cast<int>(
+            syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0)
+        );
+        if (this->fds[i] < 0 && this->error.empty()) {
+            this->error = std::string(getPerfCounterName(PerfCounter(i))) +
+                          ": " + std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd : this->fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (const int fd : this->fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+PerfSample PerfCounters::stop() {
+    for (const int fd : this->fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    PerfSample sample;
+    for (std::size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (this->fds[i] < 0) {
+            continue;
+        }
+
+        // Value, then time enabled and time actually counting
+        std::uint64_t values[3];
+        const auto size = static_cast<ssize_t>(sizeof(values));
+        if (read(this->fds[i], values, sizeof(values)) != size) {
+            continue;
+        }
+
+        // Never scheduled, e.g. with every hardware counter taken
+        if (values[2] == 0) {
+            continue;
+        }
+        sample.counts[i] =
+            values[2] < values[1] ?
+                static_cast<std::uint64_t>(
+                    double(values[0]) * double(values[1]) / double(values[2])
+                ) :
+                values[0];
+    }
+    return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() : error("Only supported on Linux") {
+    this->fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() {}
+
+PerfSample PerfCounters::stop() {
+    return {};
+}
+
+#endif
+
+bool PerfCounters::isAvailable() const {
+    for (const int fd : this->fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
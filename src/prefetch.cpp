@@ -0,0 +1,135 @@
+#include "prefetch.h"
+
+using sudoku_engine::PrefetchStats;
+using sudoku_engine::PuzzlePrefetcher;
+
+PuzzlePrefetcher::PuzzlePrefetcher(std::size_t depth, Source source)
+    : slots(std::make_unique<Slot[]>(depth)), depth(depth),
+      source(std::move(source)) {
+    for (std::size_t i = 0; i < depth; i++) {
+        this->slots[i].sequence = i;
+    }
+
+    this->reader = std::jthread([this]() { this->readPuzzles(); });
+}
+
+PuzzlePrefetcher::~PuzzlePrefetcher() {
+    this->stop();
+}
+
+void PuzzlePrefetcher::readPuzzles() {
+    for (std::size_t position = 0;; position++) {
+        Slot& slot = this->slots[position % this->depth];
+
+        // Wait for whoever took the puzzle last in this slot to hand it back
+        bool stalled = false;
+        while (true) {
+            const std::uint32_t seen_version = this->freed_version.load();
+            if (this->is_stopped) {
+                return;
+            }
+            if (slot.sequence.load(std::memory_order_acquire) == position) {
+                break;
+            }
+
+            stalled = true;
+            this->freed_version.wait(seen_version);
+        }
+        if (stalled) {
+            this->reader_stalls++;
+        }
+
+        bool has_puzzle = false;
+        try {
+            has_puzzle =
+                this->source(slot.puzzle.cages, slot.puzzle.solution);
+        } catch (...) {
+            this->error = std::current_exception();
+        }
+
+        if (!has_puzzle) {
+            this->is_done = true;
+            this->filled_version++;
+            this->filled_version.notify_all();
+            return;
+        }
+
+        slot.puzzle.index = position;
+        this->head.store(position + 1, std::memory_order_release);
+        this->filled_version++;
+        this->filled_version.notify_all();
+    }
+}
+
+bool PuzzlePrefetcher::take(PrefetchedPuzzle& puzzle) {
+    bool stalled = false;
+
+    while (!this->is_stopped) {
+        const std::uint32_t seen_version = this->filled_version.load();
+        std::size_t position = this->tail.load();
+
+        if (position < this->head.load(std::memory_order_acquire)) {
+            if (!this->tail.compare_exchange_weak(position, position + 1)) {
+                continue;
+            }
+
+            Slot& slot = this->slots[position % this->depth];
+            std::swap(puzzle, slot.puzzle);
+            slot.sequence.store(
+                position + this->depth, std::memory_order_release
+            );
+            this->freed_version++;
+            this->freed_version.notify_one();
+
+            this->ready_total += this->head.load() - position;
+            if (stalled) {
+                this->solver_stalls++;
+            }
+            return true;
+        }
+
+        // The reader may have filled a slot and run out in between the
+        // loads above, so the ring only counts as drained against the head
+        // it published before marking itself done
+        if (this->is_done) {
+            const std::size_t head =
+                this->head.load(std::memory_order_acquire);
+            if (this->tail.load() < head) {
+                continue;
+            }
+            break;
+        }
+
+        stalled = true;
+        this->filled_version.wait(seen_version);
+    }
+
+    return false;
+}
+
+void PuzzlePrefetcher::stop() {
+    this->is_stopped = true;
+    this->freed_version++;
+    this->freed_version.notify_all();
+    this->filled_version++;
+    this->filled_version.notify_all();
+}
+
+void PuzzlePrefetcher::finish() {
+    if (this->reader.joinable()) {
+        this->reader.join();
+    }
+    if (this->error) {
+        std::rethrow_exception(this->error);
+    }
+}
+
+PrefetchStats PuzzlePrefetcher::getStats() const {
+    return {
+        .depth = this->depth,
+        .taken = this->tail.load(),
+        .ready_total = this->ready_total.load(),
+        .solver_stalls = this->solver_stalls.load(),
+        .reader_stalls = this->reader_stalls
+    };
+}
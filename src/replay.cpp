@@ -0,0 +1,110 @@
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+#include "engine/board.h"
+#include "heuristic/trace.h"
+#include "replay.h"
+
+using sudoku_engine::Board;
+using sudoku_engine::BoardCell;
+using sudoku_engine::BoardPosition;
+using sudoku_engine::SearchTrace;
+using sudoku_engine::TraceEventType;
+using sudoku_engine::TraceReplayer;
+
+static void printEventCounts(const SearchTrace& trace, std::ostream& output) {
+    std::array<std::size_t, 5> type_counts = {};
+    for (const auto& event : trace.events) {
+        type_counts[std::size_t(event.type)]++;
+    }
+
+    output << "Events:              " << trace.events.size() << std::endl;
+    output << "Assignments:         "
+           << type_counts[std::size_t(TraceEventType::ASSIGN)] << std::endl;
+    output << "Prunes:              "
+           << type_counts[std::size_t(TraceEventType::PRUNE)] << std::endl;
+    output << "Backtracks:          "
+           << type_counts[std::size_t(TraceEventType::BACKTRACK)]
+           << std::endl;
+    output << "MRV Picks:           "
+           << type_counts[std::size_t(TraceEventType::MRV_PICK)]
+           << std::endl;
+}
+
+// Candidates of every empty cell, one column per cell
+static void printDomains(
+    const TraceReplayer& replayer,
+    std::ostream& output
+) {
+    const auto& values = replayer.getValues();
+
+    BoardPosition pos = {0, 0};
+    for (pos.row = 0; pos.row < sudoku_engine::BOARD_SIZE; pos.row++) {
+        for (pos.col = 0; pos.col < sudoku_engine::BOARD_SIZE; pos.col++) {
+            std::string candidates;
+            if (values[pos] == sudoku_engine::CELL_EMPTY) {
+                for (BoardCell value = sudoku_engine::CELL_MIN;
+                     value <= sudoku_engine::CELL_MAX;
+                     value++) {
+                    if (replayer.getDomains()[pos].has(value)) {
+                        candidates += char('0' + value);
+                    }
+                }
+            } else {
+                candidates = "=";
+                candidates += char('0' + values[pos]);
+            }
+            output << std::left << std::setw(10) << candidates;
+        }
+        output << std::right << std::endl;
+    }
+}
+
+int sudoku_engine::replayTrace(
+    const std::string& filename,
+    std::optional<std::size_t> step,
+    const std::optional<std::string>& chrome_filename,
+    std::ostream& output
+) {
+    std::ifstream input(filename, std::ios::binary);
+    if (!input.is_open()) {
+        output << "Could not open \"" << filename << '"' << std::endl;
+        return 1;
+    }
+    const SearchTrace trace = SearchTrace::load(input);
+    printEventCounts(trace, output);
+
+    if (chrome_filename) {
+        std::ofstream chrome_output(*chrome_filename);
+        trace.writeChromeTrace(chrome_output);
+        if (!chrome_output) {
+            output << "Could not write \"" << *chrome_filename << '"'
+                   << std::endl;
+            return 1;
+        }
+        output << "Wrote \"" << *chrome_filename << "\"." << std::endl;
+    }
+
+    if (trace.dropped_count > 0) {
+        output << "[WARN] The trace lost its first " << trace.dropped_count
+               << " events and can't be replayed." << std::endl;
+        return chrome_filename ? 0 : 1;
+    }
+
+    TraceReplayer replayer(trace);
+    replayer.seek(step.value_or(trace.events.size()));
+
+    output << std::endl
+           << "Board before event " << replayer.getPosition() << " (depth "
+           << replayer.getDepth() << "):" << std::endl;
+    Board board;
+    board.setValues(replayer.getValues());
+    board.print(output);
+
+    output << "Domains:" << std::endl;
+    printDomains(replayer, output);
+    return 0;
+}
@@ -1,16 +1,101 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SUDOKU_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define SUDOKU_HAS_MMAP 0
+#endif
 
 #include "serialization.h"
 
+using sudoku_engine::BoardCage;
+using sudoku_engine::serialization::BundleFormat;
+using sudoku_engine::serialization::Ksf2Layout;
+using sudoku_engine::serialization::MappedPuzzleLoader;
 using sudoku_engine::serialization::Puzzle;
 using sudoku_engine::serialization::PuzzleLoader;
+using sudoku_engine::serialization::PuzzleStreamReader;
+using sudoku_engine::serialization::PuzzleView;
+using sudoku_engine::serialization::PuzzleWriter;
+
+// Cage values are distinct, so a cage of no cells or more than the board's
+// size can't be filled and only trips up the solvers
+static void check_cage_size(size_t size) {
+    if (size == 0 || size > sudoku_engine::BOARD_SIZE)
+        throw std::runtime_error("Cage must have 1 to 9 cells");
+}
+
+static void check_solution(std::span<const uint8_t> solution) {
+    for (const uint8_t value : solution) {
+        if (value < sudoku_engine::CELL_MIN || value > sudoku_engine::CELL_MAX)
+            throw std::runtime_error("Invalid solution digit");
+    }
+}
+
+// Rows and columns take 4 bits each, which fit more than the board has
+static void check_cage_cells(std::span<const uint8_t> cells) {
+    for (const uint8_t pair : cells) {
+        if ((pair >> 4) >= sudoku_engine::BOARD_SIZE ||
+            (pair & 0x0F) >= sudoku_engine::BOARD_SIZE)
+            throw std::runtime_error("Invalid cage cell");
+    }
+}
+
+std::array<uint64_t, Ksf2Layout::SECTION_COUNT> Ksf2Layout::section_offsets(
+    uint32_t puzzle_count
+) {
+    std::array<uint64_t, SECTION_COUNT> offsets;
+    uint64_t offset = HEADER_SIZE;
+    for (size_t i = 0; i < SECTION_COUNT; ++i) {
+        offsets[i] = offset;
+        offset += uint64_t(puzzle_count) * RECORD_SIZES[i];
+        offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+    return offsets;
+}
+
+// Checks the KSF2 header fields past the magic and version, and returns
+// the section offsets. Shared by both loaders.
+static std::array<uint64_t, Ksf2Layout::SECTION_COUNT> read_ksf2_sections(
+    const uint8_t* header,
+    uint32_t puzzle_count
+) {
+    if (header[5] != uint8_t(Ksf2Layout::Compression::NONE))
+        throw std::runtime_error("Unsupported KS file compression");
+
+    uint32_t section_count;
+    std::memcpy(&section_count, header + 12, 4);
+    if (section_count < Ksf2Layout::SECTION_COUNT)
+        throw std::runtime_error("Missing KS file sections");
+
+    std::array<uint64_t, Ksf2Layout::SECTION_COUNT> offsets;
+    std::memcpy(offsets.data(), header + 16, sizeof(offsets));
+
+    for (size_t i = 0; i < Ksf2Layout::SECTION_COUNT; ++i) {
+        const uint64_t size =
+            uint64_t(puzzle_count) * Ksf2Layout::RECORD_SIZES[i];
+        if (offsets[i] < Ksf2Layout::HEADER_SIZE ||
+            offsets[i] + size < offsets[i])
+            throw std::runtime_error("Invalid KS file section offset");
+    }
+
+    return offsets;
+}
 
 PuzzleLoader::PuzzleLoader(std::istream& file) : file(file) {
     read_header();
-    read_index();
+    if (this->format == BundleFormat::KSF1)
+        read_index();
 }
 
 void PuzzleLoader::read_header() {
@@ -24,19 +109,36 @@ void PuzzleLoader::read_header() {
     // check magic
     uint32_t magic;
     std::memcpy(&magic, header, 4);
-    if (magic != MAGIC)
+    if (magic != MAGIC && magic != Ksf2Layout::MAGIC)
         throw std::runtime_error("Invalid KS file magic");
+    this->format =
+        magic == MAGIC ? BundleFormat::KSF1 : BundleFormat::KSF2;
 
     // check version
     uint8_t ver = header[4];
-    if (ver != VERSION)
+    if (ver != (this->format == BundleFormat::KSF1 ? VERSION :
+                                                     Ksf2Layout::VERSION))
         throw std::runtime_error("Unsupported KS file version");
 
     // read count (uint32_t little-endian)
-    uint32_t puzzle_count;
-    std::memcpy(&puzzle_count, header + 8, 4);
+    std::memcpy(&this->count, header + 8, 4);
+
+    if (this->format == BundleFormat::KSF1) {
+        this->index_offsets = utils::ArrayVector<size_t>(this->count);
+        return;
+    }
 
-    this->index_offsets = utils::ArrayVector<size_t>(puzzle_count);
+    // The rest of the larger KSF2 header
+    uint8_t full_header[Ksf2Layout::HEADER_SIZE];
+    std::memcpy(full_header, header, HEADER_SIZE);
+    this->file.read(
+        reinterpret_cast<char*>(full_header + HEADER_SIZE),
+        Ksf2Layout::HEADER_SIZE - HEADER_SIZE
+    );
+    if (!this->file)
+        throw std::runtime_error("Failed to read header");
+
+    this->section_offsets = read_ksf2_sections(full_header, this->count);
 }
 
 void PuzzleLoader::read_index() {
@@ -53,6 +155,8 @@ void PuzzleLoader::read_index() {
 std::unique_ptr<Puzzle> PuzzleLoader::load_puzzle(size_t index) {
     if (index >= this->puzzle_count())
         throw std::out_of_range("Puzzle index out of range");
+    if (this->format == BundleFormat::KSF2)
+        return load_ksf2_puzzle(index);
 
     this->file.seekg(this->index_offsets.data()[index], std::ios::beg);
 
@@ -74,6 +178,7 @@ std::unique_ptr<Puzzle> PuzzleLoader::load_puzzle(size_t index) {
 
     size_t pos = 0;
     const uint8_t num_cages = cages_span[pos++];
+    check_solution(solution_span);
 
     Puzzle* const puzzle = new Puzzle{
         .cages = utils::ArrayVector<BoardCage>(num_cages),
@@ -91,6 +196,7 @@ std::unique_ptr<Puzzle> PuzzleLoader::load_puzzle(size_t index) {
 
         const uint8_t cage_sum = cages_span[pos++];
         uint8_t cage_size = cages_span[pos++];
+        check_cage_size(cage_size);
 
         std::vector<BoardPosition> cage_cells;
         cage_cells.reserve(cage_size);
@@ -99,6 +205,7 @@ std::unique_ptr<Puzzle> PuzzleLoader::load_puzzle(size_t index) {
             throw std::runtime_error(
                 "Unexpected end of payload while reading cage coords"
             );
+        check_cage_cells(cages_span.subspan(pos, cage_size));
 
         for (uint8_t j = 0; j < cage_size; ++j) {
             const uint8_t pair = cages_span[pos++];
@@ -112,3 +219,755 @@ std::unique_ptr<Puzzle> PuzzleLoader::load_puzzle(size_t index) {
 
     return std::unique_ptr<Puzzle>(puzzle);
 }
+
+std::unique_ptr<Puzzle> PuzzleLoader::load_ksf2_puzzle(size_t index) {
+    const auto read_record = [&](Ksf2Layout::Section section, uint8_t* out) {
+        const size_t size = Ksf2Layout::RECORD_SIZES[section];
+        this->file.seekg(
+            std::streamoff(this->section_offsets[section] + index * size),
+            std::ios::beg
+        );
+        this->file.read(reinterpret_cast<char*>(out), size);
+        if (!this->file)
+            throw std::runtime_error("Failed to read puzzle record");
+    };
+
+    uint8_t solution[SOLUTION_SIZE];
+    uint8_t num_cages;
+    uint8_t sums[Ksf2Layout::MAX_CAGES];
+    uint8_t sizes[Ksf2Layout::MAX_CAGES];
+    uint8_t cells[SOLUTION_SIZE];
+    read_record(Ksf2Layout::SOLUTIONS, solution);
+    read_record(Ksf2Layout::CAGE_COUNTS, &num_cages);
+    read_record(Ksf2Layout::CAGE_SUMS, sums);
+    read_record(Ksf2Layout::CAGE_SIZES, sizes);
+    read_record(Ksf2Layout::CAGE_CELLS, cells);
+
+    if (num_cages > Ksf2Layout::MAX_CAGES)
+        throw std::runtime_error("Too many cages in puzzle record");
+
+    size_t cell_count = 0;
+    for (uint8_t i = 0; i < num_cages; ++i) {
+        check_cage_size(sizes[i]);
+        cell_count += sizes[i];
+    }
+    if (cell_count > SOLUTION_SIZE)
+        throw std::runtime_error("Cage cells run past the puzzle record");
+    check_solution(solution);
+    check_cage_cells(std::span(cells, cell_count));
+
+    Puzzle* const puzzle = new Puzzle{
+        .cages = utils::ArrayVector<BoardCage>(num_cages),
+        .solution = BoardState<BoardCell>(
+            BOARD_SIZE,
+            std::vector<BoardCell>(solution, solution + SOLUTION_SIZE)
+        )
+    };
+
+    size_t pos = 0;
+    for (uint8_t i = 0; i < num_cages; ++i) {
+        std::vector<BoardPosition> cage_cells;
+        cage_cells.reserve(sizes[i]);
+        for (uint8_t j = 0; j < sizes[i]; ++j) {
+            const uint8_t pair = cells[pos++];
+            cage_cells.emplace_back((pair >> 4) & 0x0F, pair & 0x0F);
+        }
+
+        puzzle->cages.append(BoardCage(sums[i], std::move(cage_cells)));
+    }
+
+    return std::unique_ptr<Puzzle>(puzzle);
+}
+
+void PuzzleView::decode_cages(std::vector<BoardCage>& cages) const {
+    cages.resize(this->cage_count(), BoardCage(0, {}));
+
+    size_t i = 0;
+    for (const CageView cage : *this) {
+        BoardCage& target = cages[i++];
+        target.sum = cage.sum();
+        target.cells.clear();
+        for (size_t j = 0; j < cage.size(); ++j) {
+            target.cells.push_back(cage.cell(j));
+        }
+    }
+}
+
+void PuzzleView::decode_solution(BoardState<BoardCell>& solution) const {
+    const auto values = this->solution();
+    for (BoardOffset row = 0; row < BOARD_SIZE; ++row) {
+        for (BoardOffset col = 0; col < BOARD_SIZE; ++col) {
+            solution[BoardPosition(row, col)] =
+                values[size_t(row) * BOARD_SIZE + col];
+        }
+    }
+}
+
+MappedPuzzleLoader::MappedPuzzleLoader(const std::string& filename) {
+#if SUDOKU_HAS_MMAP
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open \"" + filename + '"');
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to read size of \"" + filename + '"');
+    }
+
+    const auto size = static_cast<size_t>(info.st_size);
+    void* const mapping =
+        size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) :
+                   nullptr;
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Failed to map \"" + filename + '"');
+
+    this->mapping = mapping;
+    this->bytes = std::span(static_cast<const uint8_t*>(mapping), size);
+#else
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open \"" + filename + '"');
+
+    this->buffer.assign(
+        std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
+    );
+    this->bytes = this->buffer;
+#endif
+
+    // The destructor won't run if this throws
+    try {
+        read_header();
+    } catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+MappedPuzzleLoader::~MappedPuzzleLoader() {
+    unmap();
+}
+
+void MappedPuzzleLoader::unmap() {
+#if SUDOKU_HAS_MMAP
+    if (this->mapping != nullptr) {
+        munmap(this->mapping, this->bytes.size());
+        this->mapping = nullptr;
+    }
+#endif
+}
+
+void MappedPuzzleLoader::read_header() {
+    if (this->bytes.size() < PuzzleLoader::HEADER_SIZE)
+        throw std::runtime_error("Failed to read header");
+
+    uint32_t magic;
+    std::memcpy(&magic, this->bytes.data(), 4);
+    if (magic == Ksf2Layout::MAGIC) {
+        read_ksf2_header();
+        return;
+    }
+    if (magic != PuzzleLoader::MAGIC)
+        throw std::runtime_error("Invalid KS file magic");
+
+    if (this->bytes[4] != PuzzleLoader::VERSION)
+        throw std::runtime_error("Unsupported KS file version");
+
+    std::memcpy(&this->count, this->bytes.data() + 8, 4);
+
+    const size_t index_size = size_t(this->count) * sizeof(uint64_t);
+    if (this->bytes.size() - PuzzleLoader::HEADER_SIZE < index_size)
+        throw std::runtime_error("Failed to read index entry");
+
+    this->index = this->bytes.subspan(PuzzleLoader::HEADER_SIZE, index_size);
+}
+
+void MappedPuzzleLoader::read_ksf2_header() {
+    if (this->bytes.size() < Ksf2Layout::HEADER_SIZE)
+        throw std::runtime_error("Failed to read header");
+    if (this->bytes[4] != Ksf2Layout::VERSION)
+        throw std::runtime_error("Unsupported KS file version");
+
+    this->format = BundleFormat::KSF2;
+    std::memcpy(&this->count, this->bytes.data() + 8, 4);
+
+    const auto offsets = read_ksf2_sections(this->bytes.data(), this->count);
+    for (size_t i = 0; i < Ksf2Layout::SECTION_COUNT; ++i) {
+        const uint64_t size =
+            uint64_t(this->count) * Ksf2Layout::RECORD_SIZES[i];
+        if (offsets[i] > this->bytes.size() ||
+            this->bytes.size() - offsets[i] < size)
+            throw std::runtime_error("Failed to read section");
+        this->sections[i] = this->bytes.subspan(offsets[i], size);
+    }
+}
+
+PuzzleView MappedPuzzleLoader::view_puzzle(size_t index) const {
+    if (index >= this->puzzle_count())
+        throw std::out_of_range("Puzzle index out of range");
+    if (this->format == BundleFormat::KSF2)
+        return view_ksf2_puzzle(index);
+
+    uint64_t offset;
+    std::memcpy(
+        &offset, this->index.data() + index * sizeof(offset), sizeof(offset)
+    );
+
+    uint32_t payload_len = 0;
+    if (offset > this->bytes.size() ||
+        this->bytes.size() - offset < sizeof(payload_len))
+        throw std::runtime_error("Failed to read puzzle payload length");
+    std::memcpy(
+        &payload_len, this->bytes.data() + offset, sizeof(payload_len)
+    );
+
+    if (payload_len < PuzzleLoader::SOLUTION_SIZE + 1)
+        throw std::runtime_error("Payload too short for solution + cages");
+    if (this->bytes.size() - offset - sizeof(payload_len) < payload_len)
+        throw std::runtime_error("Failed to read puzzle payload");
+
+    return PuzzleView::from_ksf1_payload(
+        this->bytes.subspan(offset + sizeof(payload_len), payload_len)
+    );
+}
+
+PuzzleView PuzzleView::from_ksf1_payload(std::span<const uint8_t> payload) {
+    if (payload.size() < PuzzleLoader::SOLUTION_SIZE + 1)
+        throw std::runtime_error("Payload too short for solution + cages");
+
+    check_solution(payload.first(PuzzleLoader::SOLUTION_SIZE));
+
+    // Walk the cages once, so that reading the view can't run off the end
+    // or the board
+    const uint8_t num_cages = payload[PuzzleLoader::SOLUTION_SIZE];
+    size_t pos = PuzzleLoader::SOLUTION_SIZE + 1;
+    for (uint8_t i = 0; i < num_cages; ++i) {
+        if (pos + 2 > payload.size())
+            throw std::runtime_error(
+                "Unexpected end of payload while reading cage header"
+            );
+
+        const uint8_t cage_size = payload[pos + 1];
+        check_cage_size(cage_size);
+        pos += 2 + cage_size;
+        if (pos > payload.size())
+            throw std::runtime_error(
+                "Unexpected end of payload while reading cage coords"
+            );
+        check_cage_cells(payload.subspan(pos - cage_size, cage_size));
+    }
+
+    return PuzzleView(
+        payload.data(),
+        num_cages,
+        PuzzleView::CageIterator(
+            payload.data() + PuzzleLoader::SOLUTION_SIZE + 1
+        ),
+        payload.data() + pos
+    );
+}
+
+PuzzleView MappedPuzzleLoader::view_ksf2_puzzle(size_t index) const {
+    const auto record = [&](Ksf2Layout::Section section) {
+        const size_t size = Ksf2Layout::RECORD_SIZES[section];
+        return this->sections[section].subspan(index * size, size);
+    };
+
+    const uint8_t num_cages = record(Ksf2Layout::CAGE_COUNTS)[0];
+    if (num_cages > Ksf2Layout::MAX_CAGES)
+        throw std::runtime_error("Too many cages in puzzle record");
+
+    const auto sizes = record(Ksf2Layout::CAGE_SIZES);
+    size_t cell_count = 0;
+    for (uint8_t i = 0; i < num_cages; ++i) {
+        check_cage_size(sizes[i]);
+        cell_count += sizes[i];
+    }
+    if (cell_count > PuzzleLoader::SOLUTION_SIZE)
+        throw std::runtime_error("Cage cells run past the puzzle record");
+
+    const auto solution = record(Ksf2Layout::SOLUTIONS);
+    const auto cells = record(Ksf2Layout::CAGE_CELLS);
+    check_solution(solution);
+    check_cage_cells(cells.first(cell_count));
+    return PuzzleView(
+        solution.data(),
+        num_cages,
+        PuzzleView::CageIterator(
+            cells.data(), record(Ksf2Layout::CAGE_SUMS).data(), sizes.data()
+        ),
+        cells.data() + cell_count
+    );
+}
+
+PuzzleStreamReader::PuzzleStreamReader(std::istream& file) : file(file) {
+    for (Chunk& chunk : this->chunks) {
+        chunk.data.resize(CHUNK_SIZE);
+    }
+    this->reader = std::jthread([this](std::stop_token stop_token) {
+        read_chunks(stop_token);
+    });
+
+    // Told apart by the first byte, text starts with a digit
+    if (!next_chunk())
+        return;
+    if (this->unread[0] != char(PuzzleLoader::MAGIC & 0xFF))
+        return;
+
+    uint8_t header[PuzzleLoader::HEADER_SIZE];
+    if (!read_bytes(header, PuzzleLoader::HEADER_SIZE))
+        throw std::runtime_error("Failed to read header");
+
+    uint32_t magic;
+    std::memcpy(&magic, header, 4);
+    if (magic == Ksf2Layout::MAGIC)
+        throw std::runtime_error(
+            "KSF2 bundles can't be streamed, convert them to KSF1 or text"
+        );
+    if (magic != PuzzleLoader::MAGIC)
+        throw std::runtime_error("Invalid KS file magic");
+    if (header[4] != PuzzleLoader::VERSION)
+        throw std::runtime_error("Unsupported KS file version");
+
+    this->format = BundleFormat::KSF1;
+    std::memcpy(&this->remaining, header + 8, 4);
+
+    // The puzzles follow in index order, so the index isn't needed
+    if (!skip_bytes(uint64_t(this->remaining) * sizeof(uint64_t)))
+        throw std::runtime_error("Failed to read index entry");
+}
+
+void PuzzleStreamReader::read_chunks(std::stop_token stop_token) {
+    for (size_t i = 0;; i ^= 1) {
+        Chunk& chunk = this->chunks[i];
+        {
+            std::unique_lock lock(this->chunk_mutex);
+            if (!this->chunk_ready.wait(
+                    lock, stop_token, [&] { return !chunk.is_full; }
+                ))
+                return;
+        }
+
+        // Waits for one byte, then takes whatever else has arrived, so the
+        // puzzles of a slow producer are parsed as they come
+        size_t size = 0;
+        if (this->file.peek() != std::istream::traits_type::eof()) {
+            size = static_cast<size_t>(
+                this->file.readsome(chunk.data.data(), CHUNK_SIZE)
+            );
+            // Streams that can't tell what's buffered go a byte at a time
+            if (size == 0) {
+                this->file.read(chunk.data.data(), 1);
+                size = static_cast<size_t>(this->file.gcount());
+            }
+        }
+
+        std::lock_guard lock(this->chunk_mutex);
+        chunk.size = size;
+        chunk.is_full = true;
+        this->read_failed = this->file.bad();
+        this->chunk_ready.notify_all();
+        if (size == 0)
+            return;
+    }
+}
+
+bool PuzzleStreamReader::next_chunk() {
+    if (this->at_end)
+        return false;
+
+    std::unique_lock lock(this->chunk_mutex);
+    if (this->holds_chunk) {
+        this->chunks[this->current].is_full = false;
+        this->current ^= 1;
+        this->chunk_ready.notify_all();
+    }
+
+    const Chunk& chunk = this->chunks[this->current];
+    this->chunk_ready.wait(lock, [&] { return chunk.is_full; });
+    this->holds_chunk = true;
+    if (this->read_failed)
+        throw std::runtime_error("Failed to read puzzle stream");
+
+    this->unread = std::span(chunk.data.data(), chunk.size);
+    // Only the end of the stream leaves a chunk empty
+    this->at_end = chunk.size == 0;
+    return !this->at_end;
+}
+
+bool PuzzleStreamReader::read_bytes(uint8_t* out, size_t size) {
+    while (size > 0) {
+        if (this->unread.empty() && !next_chunk())
+            return false;
+
+        const size_t count = std::min(size, this->unread.size());
+        std::memcpy(out, this->unread.data(), count);
+        this->unread = this->unread.subspan(count);
+        out += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool PuzzleStreamReader::skip_bytes(uint64_t size) {
+    while (size > 0) {
+        if (this->unread.empty() && !next_chunk())
+            return false;
+
+        const auto count =
+            static_cast<size_t>(std::min<uint64_t>(size, this->unread.size()));
+        this->unread = this->unread.subspan(count);
+        size -= count;
+    }
+    return true;
+}
+
+bool PuzzleStreamReader::read_line(std::string& out) {
+    out.clear();
+    while (true) {
+        if (this->unread.empty() && !next_chunk())
+            return !out.empty();
+
+        const void* const end =
+            std::memchr(this->unread.data(), '\n', this->unread.size());
+        if (end == nullptr) {
+            out.append(this->unread.data(), this->unread.size());
+            this->unread = {};
+            continue;
+        }
+
+        const auto count = static_cast<size_t>(
+            static_cast<const char*>(end) - this->unread.data()
+        );
+        out.append(this->unread.data(), count);
+        this->unread = this->unread.subspan(count + 1);
+        return true;
+    }
+}
+
+bool PuzzleStreamReader::read_puzzle(
+    std::vector<BoardCage>& cages,
+    BoardState<BoardCell>& solution
+) {
+    return this->format == BundleFormat::KSF1 ?
+               read_ksf1_puzzle(cages, solution) :
+               read_text_puzzle(cages, solution);
+}
+
+bool PuzzleStreamReader::read_ksf1_puzzle(
+    std::vector<BoardCage>& cages,
+    BoardState<BoardCell>& solution
+) {
+    if (this->remaining == 0)
+        return false;
+
+    uint32_t payload_len = 0;
+    if (!read_bytes(
+            reinterpret_cast<uint8_t*>(&payload_len), sizeof(payload_len)
+        ))
+        throw std::runtime_error("Failed to read puzzle payload length");
+    if (payload_len > MAX_PAYLOAD_SIZE)
+        throw std::runtime_error("Payload too long for one puzzle");
+
+    this->payload.resize(payload_len);
+    if (!read_bytes(this->payload.data(), payload_len))
+        throw std::runtime_error("Failed to read puzzle payload");
+
+    const PuzzleView view = PuzzleView::from_ksf1_payload(this->payload);
+    view.decode_cages(cages);
+    view.decode_solution(solution);
+    this->remaining--;
+    return true;
+}
+
+bool PuzzleStreamReader::read_text_puzzle(
+    std::vector<BoardCage>& cages,
+    BoardState<BoardCell>& solution
+) {
+    // Blank lines and '#' comments are skipped
+    do {
+        if (!read_line(this->line))
+            return false;
+        this->line_number++;
+        if (!this->line.empty() && this->line.back() == '\r')
+            this->line.pop_back();
+    } while (this->line.empty() || this->line[0] == '#');
+
+    const auto fail = [&](const char* message) {
+        throw std::runtime_error(
+            std::string(message) + " on line " +
+            std::to_string(this->line_number)
+        );
+    };
+    const auto is_digit = [](char c, char max) {
+        return c >= '0' && c <= max;
+    };
+
+    const std::string_view text = this->line;
+    if (text.size() < PuzzleLoader::SOLUTION_SIZE)
+        fail("Solution too short");
+    for (size_t i = 0; i < PuzzleLoader::SOLUTION_SIZE; ++i) {
+        if (!is_digit(text[i], '9') || text[i] == '0')
+            fail("Invalid solution digit");
+        solution[BoardPosition(
+            BoardOffset(i / BOARD_SIZE), BoardOffset(i % BOARD_SIZE)
+        )] = BoardCell(text[i] - '0');
+    }
+
+    // Decoded into the same storage every time, like PuzzleView does
+    size_t cage_count = 0;
+    size_t pos = PuzzleLoader::SOLUTION_SIZE;
+    while (true) {
+        while (pos < text.size() && text[pos] == ' ') {
+            pos++;
+        }
+        if (pos == text.size())
+            break;
+
+        unsigned sum = 0;
+        const size_t sum_start = pos;
+        while (pos < text.size() && is_digit(text[pos], '9') &&
+               pos - sum_start < 2) {
+            sum = sum * 10 + unsigned(text[pos++] - '0');
+        }
+        if (pos == sum_start || pos == text.size() || text[pos++] != ':')
+            fail("Invalid cage sum");
+
+        if (cage_count == cages.size())
+            cages.emplace_back(0, std::vector<BoardPosition>());
+        BoardCage& cage = cages[cage_count++];
+        cage.sum = sum;
+        cage.cells.clear();
+
+        const char max = char('0' + BOARD_SIZE - 1);
+        while (true) {
+            if (pos + 2 > text.size() || !is_digit(text[pos], max) ||
+                !is_digit(text[pos + 1], max))
+                fail("Invalid cage cell");
+            cage.cells.emplace_back(
+                BoardOffset(text[pos] - '0'), BoardOffset(text[pos + 1] - '0')
+            );
+            pos += 2;
+            if (cage.cells.size() > BOARD_SIZE)
+                fail("Too many cage cells");
+
+            if (pos == text.size() || text[pos] != ',')
+                break;
+            pos++;
+        }
+    }
+
+    cages.resize(cage_count, BoardCage(0, {}));
+    return true;
+}
+
+PuzzleWriter::PuzzleWriter(
+    std::ostream& file,
+    std::uint32_t puzzle_count,
+    BundleFormat format
+)
+    : file(file), format(format), expected_count(puzzle_count) {
+    if (format == BundleFormat::TEXT)
+        return;
+    if (format == BundleFormat::KSF2) {
+        // Filled in place, and written out by finish()
+        for (size_t i = 0; i < Ksf2Layout::SECTION_COUNT; ++i) {
+            this->sections[i].resize(
+                size_t(puzzle_count) * Ksf2Layout::RECORD_SIZES[i]
+            );
+        }
+        return;
+    }
+
+    uint8_t header[PuzzleLoader::HEADER_SIZE] = {};
+    std::memcpy(header, &PuzzleLoader::MAGIC, 4);
+    header[4] = PuzzleLoader::VERSION;
+    std::memcpy(header + 8, &puzzle_count, 4);
+    this->file.write(
+        reinterpret_cast<const char*>(header), PuzzleLoader::HEADER_SIZE
+    );
+
+    // Placeholder index, overwritten by finish()
+    const uint64_t no_offset = 0;
+    for (uint32_t i = 0; i < puzzle_count; ++i) {
+        this->file.write(
+            reinterpret_cast<const char*>(&no_offset), sizeof(no_offset)
+        );
+    }
+
+    if (!this->file)
+        throw std::runtime_error("Failed to write header");
+    this->index_offsets.reserve(puzzle_count);
+}
+
+void PuzzleWriter::save_puzzle(const Puzzle& puzzle) {
+    if (this->saved_count >= this->expected_count)
+        throw std::out_of_range("More puzzles than the header announced");
+
+    if (this->format == BundleFormat::KSF2) {
+        save_ksf2_puzzle(puzzle);
+    } else if (this->format == BundleFormat::TEXT) {
+        save_text_puzzle(puzzle);
+    } else {
+        save_ksf1_puzzle(puzzle);
+    }
+    this->saved_count++;
+}
+
+void PuzzleWriter::save_ksf1_puzzle(const Puzzle& puzzle) {
+    const auto cages = puzzle.cages.data();
+    if (cages.size() > UINT8_MAX)
+        throw std::runtime_error("Too many cages for one puzzle");
+
+    // Solution, cage count, then a sum, a size and the cells of each cage
+    std::vector<uint8_t> payload;
+    payload.reserve(2 * PuzzleLoader::SOLUTION_SIZE + 1 + 2 * cages.size());
+
+    for (BoardOffset row = 0; row < BOARD_SIZE; ++row) {
+        for (BoardOffset col = 0; col < BOARD_SIZE; ++col) {
+            payload.push_back(puzzle.solution[BoardPosition(row, col)]);
+        }
+    }
+
+    payload.push_back(static_cast<uint8_t>(cages.size()));
+    for (const BoardCage& cage : cages) {
+        payload.push_back(static_cast<uint8_t>(cage.sum));
+        payload.push_back(static_cast<uint8_t>(cage.cells.size()));
+        for (const BoardPosition& pos : cage.cells) {
+            payload.push_back(static_cast<uint8_t>((pos.row << 4) | pos.col));
+        }
+    }
+
+    this->index_offsets.push_back(static_cast<uint64_t>(this->file.tellp()));
+
+    const auto payload_len = static_cast<uint32_t>(payload.size());
+    this->file.write(
+        reinterpret_cast<const char*>(&payload_len), sizeof(payload_len)
+    );
+    this->file.write(
+        reinterpret_cast<const char*>(payload.data()), payload.size()
+    );
+    if (!this->file)
+        throw std::runtime_error("Failed to write puzzle payload");
+}
+
+void PuzzleWriter::save_ksf2_puzzle(const Puzzle& puzzle) {
+    const auto cages = puzzle.cages.data();
+    if (cages.size() > Ksf2Layout::MAX_CAGES)
+        throw std::runtime_error("Too many cages for one puzzle");
+
+    const auto record = [&](Ksf2Layout::Section section) {
+        const size_t size = Ksf2Layout::RECORD_SIZES[section];
+        return std::span(this->sections[section])
+            .subspan(this->saved_count * size, size);
+    };
+
+    const auto solution = record(Ksf2Layout::SOLUTIONS);
+    for (BoardOffset row = 0; row < BOARD_SIZE; ++row) {
+        for (BoardOffset col = 0; col < BOARD_SIZE; ++col) {
+            solution[size_t(row) * BOARD_SIZE + col] =
+                puzzle.solution[BoardPosition(row, col)];
+        }
+    }
+
+    const auto sums = record(Ksf2Layout::CAGE_SUMS);
+    const auto sizes = record(Ksf2Layout::CAGE_SIZES);
+    const auto cells = record(Ksf2Layout::CAGE_CELLS);
+
+    record(Ksf2Layout::CAGE_COUNTS)[0] = static_cast<uint8_t>(cages.size());
+    size_t pos = 0;
+    for (size_t i = 0; i < cages.size(); ++i) {
+        const BoardCage& cage = cages[i];
+        if (pos + cage.cells.size() > cells.size())
+            throw std::runtime_error("Too many cage cells for one puzzle");
+
+        sums[i] = static_cast<uint8_t>(cage.sum);
+        sizes[i] = static_cast<uint8_t>(cage.cells.size());
+        for (const BoardPosition& cell : cage.cells) {
+            cells[pos++] = static_cast<uint8_t>((cell.row << 4) | cell.col);
+        }
+    }
+}
+
+void PuzzleWriter::save_text_puzzle(const Puzzle& puzzle) {
+    std::string text;
+    text.reserve(4 * PuzzleLoader::SOLUTION_SIZE);
+
+    for (BoardOffset row = 0; row < BOARD_SIZE; ++row) {
+        for (BoardOffset col = 0; col < BOARD_SIZE; ++col) {
+            text += char('0' + puzzle.solution[BoardPosition(row, col)]);
+        }
+    }
+
+    for (const BoardCage& cage : puzzle.cages.data()) {
+        text += ' ';
+        text += std::to_string(cage.sum);
+        char separator = ':';
+        for (const BoardPosition& pos : cage.cells) {
+            text += separator;
+            text += char('0' + pos.row);
+            text += char('0' + pos.col);
+            separator = ',';
+        }
+    }
+    text += '\n';
+
+    this->file.write(text.data(), std::streamsize(text.size()));
+    if (!this->file)
+        throw std::runtime_error("Failed to write puzzle line");
+}
+
+void PuzzleWriter::finish() {
+    if (this->saved_count != this->expected_count)
+        throw std::runtime_error("Fewer puzzles than the header announced");
+
+    if (this->format == BundleFormat::TEXT) {
+        this->file.flush();
+        if (!this->file)
+            throw std::runtime_error("Failed to write puzzle line");
+        return;
+    }
+
+    if (this->format == BundleFormat::KSF2) {
+        const auto offsets = Ksf2Layout::section_offsets(this->expected_count);
+        const uint32_t section_count = Ksf2Layout::SECTION_COUNT;
+
+        uint8_t header[Ksf2Layout::HEADER_SIZE] = {};
+        std::memcpy(header, &Ksf2Layout::MAGIC, 4);
+        header[4] = Ksf2Layout::VERSION;
+        header[5] = uint8_t(Ksf2Layout::Compression::NONE);
+        std::memcpy(header + 8, &this->expected_count, 4);
+        std::memcpy(header + 12, &section_count, 4);
+        std::memcpy(header + 16, offsets.data(), sizeof(offsets));
+        this->file.write(
+            reinterpret_cast<const char*>(header), Ksf2Layout::HEADER_SIZE
+        );
+
+        // Zero padding up to each section
+        uint64_t written = Ksf2Layout::HEADER_SIZE;
+        const char padding[Ksf2Layout::ALIGNMENT] = {};
+        for (size_t i = 0; i < Ksf2Layout::SECTION_COUNT; ++i) {
+            this->file.write(padding, std::streamsize(offsets[i] - written));
+            this->file.write(
+                reinterpret_cast<const char*>(this->sections[i].data()),
+                this->sections[i].size()
+            );
+            written = offsets[i] + this->sections[i].size();
+        }
+        this->file.flush();
+        if (!this->file)
+            throw std::runtime_error("Failed to write sections");
+        return;
+    }
+
+    this->file.seekp(PuzzleLoader::HEADER_SIZE, std::ios::beg);
+    this->file.write(
+        reinterpret_cast<const char*>(this->index_offsets.data()),
+        this->index_offsets.size() * sizeof(uint64_t)
+    );
+    this->file.seekp(0, std::ios::end);
+    this->file.flush();
+    if (!this->file)
+        throw std::runtime_error("Failed to write index");
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions to count every allocation of the
+// process, so a benchmark can tell how many its operation makes, or a test
+// check a solve for making none. The replacements are defined here, so only
+// one file of an executable includes it.
+namespace sudoku_engine::test {
+    inline std::atomic<std::size_t> allocation_count = 0;
+
+    inline void* allocateAligned(std::size_t size, std::size_t alignment) {
+#ifdef _WIN32
+        return _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        const std::size_t rounded =
+            (size + alignment - 1) / alignment * alignment;
+        return std::aligned_alloc(
+            alignment, rounded == 0 ? alignment : rounded
+        );
+#endif
+    }
+
+    inline void freeAligned(void* memory) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+}
+
+void* operator new(std::size_t size) {
+    sudoku_engine::test::allocation_count.fetch_add(
+        1, std::memory_order_relaxed
+    );
+    if (void* const memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    sudoku_engine::test::allocation_count.fetch_add(
+        1, std::memory_order_relaxed
+    );
+    if (void* const memory = sudoku_engine::test::allocateAligned(
+            size, static_cast<std::size_t>(align)
+        )) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    sudoku_engine::test::freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    sudoku_engine::test::freeAligned(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    sudoku_engine::test::freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    sudoku_engine::test::freeAligned(memory);
+}
@@ -0,0 +1,76 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "engine/board.h"
+#include "engine/solver.h"
+#include "serialization.h"
+#include "test.h"
+
+using sudoku_engine::Board;
+using sudoku_engine::BoardCage;
+using sudoku_engine::SearchStatus;
+using sudoku_engine::Solver;
+using sudoku_engine::serialization::MappedPuzzleLoader;
+using sudoku_engine::test::allocation_count;
+using sudoku_engine::test::check;
+using sudoku_engine::test::getBundlePath;
+using sudoku_engine::test::getSearch;
+using sudoku_engine::test::loadPuzzle;
+using sudoku_engine::test::NamedSearch;
+
+// Solves the first puzzles of the bundle with one search, which has to
+// solve each of them without allocating once it's been constructed
+static void checkSolves(
+    const MappedPuzzleLoader& loader,
+    const NamedSearch& search
+) {
+    constexpr std::size_t SOLVE_COUNT = 100;
+
+    Board board;
+    const auto heuristic = search.factory(board);
+    Solver solver;
+    std::vector<BoardCage> cages;
+
+    // Returns the allocations made by the solve alone
+    const auto solve = [&](std::size_t index, SearchStatus& status) {
+        loadPuzzle(loader, index, board, *heuristic, cages);
+
+        const std::size_t allocations_before = allocation_count;
+        status = solver.solve(*heuristic);
+        return allocation_count - allocations_before;
+    };
+
+    // Tables shared by the whole process, like the board's peer lists, are
+    // built on first use
+    SearchStatus status;
+    solve(0, status);
+
+    for (std::size_t i = 0; i < SOLVE_COUNT; i++) {
+        const std::size_t allocations = solve(i, status);
+
+        const std::string puzzle_name =
+            std::string(search.name) + " on puzzle " + std::to_string(i);
+        check(status == SearchStatus::SOLVED, puzzle_name + " unsolved");
+        check(
+            allocations == 0,
+            puzzle_name + " allocated " + std::to_string(allocations) +
+                " times"
+        );
+    }
+}
+
+int main() {
+    const MappedPuzzleLoader loader(getBundlePath("cage-le-5.ks"));
+
+    for (const std::string_view name :
+         {"forward-mrv-lcv",
+          "forward-mrv-luby",
+          "propagate",
+          "propagate-alcv"}) {
+        checkSolves(loader, getSearch(name));
+    }
+
+    return sudoku_engine::test::getExitStatus();
+}
@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "serialization.h"
+#include "test.h"
+
+using sudoku_engine::BoardCage;
+using sudoku_engine::BoardCell;
+using sudoku_engine::BoardState;
+using sudoku_engine::serialization::BundleFormat;
+using sudoku_engine::serialization::Ksf2Layout;
+using sudoku_engine::serialization::MappedPuzzleLoader;
+using sudoku_engine::serialization::Puzzle;
+using sudoku_engine::serialization::PuzzleLoader;
+using sudoku_engine::serialization::PuzzleStreamReader;
+using sudoku_engine::serialization::PuzzleWriter;
+using sudoku_engine::test::check;
+using sudoku_engine::test::getBundlePath;
+
+using Puzzles = std::vector<std::unique_ptr<Puzzle>>;
+
+static const std::string SOLUTION =
+    "123456789578139624496872153952381467641297835"
+    "387564291719623548864915372235748916";
+
+static std::string readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << file.rdbuf();
+    return bytes.str();
+}
+
+static Puzzles loadBundle(const std::string& bytes) {
+    std::istringstream input(bytes);
+    PuzzleLoader loader(input);
+
+    Puzzles puzzles;
+    for (std::size_t i = 0; i < loader.puzzle_count(); i++) {
+        puzzles.push_back(loader.load_puzzle(i));
+    }
+    return puzzles;
+}
+
+static std::string writeBundle(const Puzzles& puzzles, BundleFormat format) {
+    std::ostringstream output;
+    PuzzleWriter writer(
+        output, static_cast<std::uint32_t>(puzzles.size()), format
+    );
+    for (const auto& puzzle : puzzles) {
+        writer.save_puzzle(*puzzle);
+    }
+    writer.finish();
+    return output.str();
+}
+
+static bool isSameCages(
+    std::span<const BoardCage> a,
+    std::span<const BoardCage> b
+) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.size(); i++) {
+        if (a[i].sum != b[i].sum || a[i].cells != b[i].cells) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void checkSamePuzzles(
+    const Puzzles& expected,
+    const Puzzles& actual,
+    std::string_view what
+) {
+    check(
+        actual.size() == expected.size(),
+        std::string(what) + " has the wrong puzzle count"
+    );
+    for (std::size_t i = 0; i < std::min(expected.size(), actual.size());
+         i++) {
+        const std::string puzzle = std::string(what) + " puzzle " +
+                                   std::to_string(i);
+        check(
+            actual[i]->solution == expected[i]->solution,
+            puzzle + " has another solution"
+        );
+        check(
+            isSameCages(actual[i]->cages.data(), expected[i]->cages.data()),
+            puzzle + " has other cages"
+        );
+    }
+}
+
+// KSF1 to KSF2 and back gives the same bundle, byte for byte, and both
+// loaders read the same puzzles out of the KSF2 one
+static void checkKsf2RoundTrip(const std::string& filename) {
+    const std::string ksf1 = readFile(filename);
+    const Puzzles puzzles = loadBundle(ksf1);
+    check(!puzzles.empty(), filename + " has no puzzles");
+
+    const std::string ksf2 = writeBundle(puzzles, BundleFormat::KSF2);
+    {
+        std::istringstream input(ksf2);
+        const PuzzleLoader loader(input);
+        check(
+            loader.bundle_format() == BundleFormat::KSF2,
+            "KSF2 bundle read as another format"
+        );
+    }
+    const Puzzles ksf2_puzzles = loadBundle(ksf2);
+    checkSamePuzzles(puzzles, ksf2_puzzles, "KSF2");
+
+    check(
+        writeBundle(ksf2_puzzles, BundleFormat::KSF1) == ksf1,
+        "KSF1 written back from KSF2 differs from " + filename
+    );
+
+    // The mapped loader only opens files
+    const auto mapped_filename =
+        std::filesystem::temp_directory_path() / "sudoku-engine-test.ks";
+    std::ofstream(mapped_filename, std::ios::binary) << ksf2;
+    {
+        const MappedPuzzleLoader loader(mapped_filename.string());
+        check(
+            loader.puzzle_count() == puzzles.size(),
+            "Mapped KSF2 has the wrong puzzle count"
+        );
+
+        std::vector<BoardCage> cages;
+        BoardState<BoardCell> solution(
+            sudoku_engine::BOARD_SIZE, sudoku_engine::CELL_EMPTY
+        );
+        for (std::size_t i = 0; i < loader.puzzle_count(); i++) {
+            const auto view = loader.view_puzzle(i);
+            view.decode_cages(cages);
+            view.decode_solution(solution);
+
+            const std::string puzzle =
+                "Mapped KSF2 puzzle " + std::to_string(i);
+            check(
+                solution == puzzles[i]->solution,
+                puzzle + " has another solution"
+            );
+            check(
+                isSameCages(cages, puzzles[i]->cages.data()),
+                puzzle + " has other cages"
+            );
+        }
+    }
+    std::filesystem::remove(mapped_filename);
+}
+
+// Reads everything through the streaming reader, as from a pipe
+static Puzzles streamBundle(const std::string& bytes, BundleFormat format) {
+    std::istringstream input(bytes);
+    PuzzleStreamReader reader(input);
+    check(
+        reader.bundle_format() == format,
+        "Streamed bundle read as another format"
+    );
+
+    std::vector<BoardCage> cages;
+    BoardState<BoardCell> solution(
+        sudoku_engine::BOARD_SIZE, sudoku_engine::CELL_EMPTY
+    );
+    Puzzles puzzles;
+    while (reader.read_puzzle(cages, solution)) {
+        auto puzzle = std::make_unique<Puzzle>(Puzzle{
+            .cages = sudoku_engine::utils::ArrayVector<BoardCage>(cages.size()),
+            .solution = solution
+        });
+        for (const BoardCage& cage : cages) {
+            puzzle->cages.append(cage);
+        }
+        puzzles.push_back(std::move(puzzle));
+    }
+    return puzzles;
+}
+
+// Text written out and streamed back in gives the same puzzles, and the
+// same text again. Streamed KSF1 gives what the seeking loader does.
+static void checkTextRoundTrip(const std::string& filename) {
+    const std::string ksf1 = readFile(filename);
+    const Puzzles puzzles = loadBundle(ksf1);
+
+    checkSamePuzzles(
+        puzzles, streamBundle(ksf1, BundleFormat::KSF1), "Streamed KSF1"
+    );
+
+    const std::string text = writeBundle(puzzles, BundleFormat::TEXT);
+    check(
+        text.size() > 2 * PuzzleStreamReader::CHUNK_SIZE,
+        "Text too short to span several chunks"
+    );
+    const Puzzles text_puzzles = streamBundle(text, BundleFormat::TEXT);
+    checkSamePuzzles(puzzles, text_puzzles, "Text");
+    check(
+        writeBundle(text_puzzles, BundleFormat::TEXT) == text,
+        "Text written back differs"
+    );
+}
+
+// Malformed lines are rejected with the line they're on
+static void checkTextErrors() {
+    const std::vector<std::pair<std::string, std::string_view>> lines = {
+        {SOLUTION.substr(0, 80), "short solution"},
+        {SOLUTION + " 45", "cage without cells"},
+        {SOLUTION + " 3:09", "cell out of the board"},
+        {SOLUTION + " 45:00,01,02,03,04,05,06,07,08,10", "ten cell cage"}
+    };
+
+    for (const auto& [line, what] : lines) {
+        bool threw = false;
+        try {
+            streamBundle(
+                SOLUTION + " 3:00,01\n" + line + '\n', BundleFormat::TEXT
+            );
+        } catch (const std::runtime_error& error) {
+            threw = std::string_view(error.what()).ends_with("on line 2");
+        }
+        check(threw, "Text with a " + std::string(what) + " not rejected");
+    }
+}
+
+template <class F>
+static bool throwsRuntimeError(F&& read) {
+    try {
+        read();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Binary bundles are checked as they're read too, so solution digits and
+// cells off the board never reach a board
+static void checkBinaryErrors() {
+    const Puzzles puzzles =
+        streamBundle(SOLUTION + " 3:00,01\n", BundleFormat::TEXT);
+    const std::string ksf1 = writeBundle(puzzles, BundleFormat::KSF1);
+    const std::string ksf2 = writeBundle(puzzles, BundleFormat::KSF2);
+
+    // After the header, the only index entry and the payload length
+    const std::size_t ksf1_solution = PuzzleLoader::HEADER_SIZE +
+                                      sizeof(std::uint64_t) +
+                                      sizeof(std::uint32_t);
+    // After the solution, the cage count, sum and size
+    const std::size_t ksf1_cell =
+        ksf1_solution + PuzzleLoader::SOLUTION_SIZE + 3;
+    const auto ksf2_offsets = Ksf2Layout::section_offsets(1);
+
+    struct Corruption {
+        const std::string& bundle;
+        std::size_t offset;
+        std::uint8_t byte;
+        std::string_view what;
+    };
+    const std::vector<Corruption> corruptions = {
+        {ksf1, ksf1_solution, 0, "KSF1 solution digit 0"},
+        {ksf1, ksf1_solution + 80, 10, "KSF1 solution digit 10"},
+        {ksf1, ksf1_cell, 0x90, "KSF1 cell in row 9"},
+        {ksf1, ksf1_cell, 0x0F, "KSF1 cell in column 15"},
+        {ksf2,
+         ksf2_offsets[Ksf2Layout::SOLUTIONS],
+         0,
+         "KSF2 solution digit 0"},
+        {ksf2,
+         ksf2_offsets[Ksf2Layout::CAGE_CELLS],
+         0xF0,
+         "KSF2 cell in row 15"}
+    };
+
+    const auto mapped_filename =
+        std::filesystem::temp_directory_path() / "sudoku-engine-test.ks";
+    for (const Corruption& corruption : corruptions) {
+        std::string bytes = corruption.bundle;
+        bytes[corruption.offset] = char(corruption.byte);
+        const std::string what(corruption.what);
+
+        check(
+            throwsRuntimeError([&]() { loadBundle(bytes); }),
+            what + " loaded"
+        );
+
+        std::ofstream(mapped_filename, std::ios::binary) << bytes;
+        check(
+            throwsRuntimeError([&]() {
+                MappedPuzzleLoader(mapped_filename.string()).view_puzzle(0);
+            }),
+            what + " viewed"
+        );
+
+        if (&corruption.bundle == &ksf1) {
+            check(
+                throwsRuntimeError([&]() {
+                    streamBundle(bytes, BundleFormat::KSF1);
+                }),
+                what + " streamed"
+            );
+        }
+    }
+    std::filesystem::remove(mapped_filename);
+}
+
+int main() {
+    for (const char* const bundle : {"cage-le-2.ks", "cage-le-9.ks"}) {
+        const std::string filename = getBundlePath(bundle);
+        checkKsf2RoundTrip(filename);
+        checkTextRoundTrip(filename);
+    }
+    checkTextErrors();
+    checkBinaryErrors();
+
+    return sudoku_engine::test::getExitStatus();
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "engine/board.h"
+#include "engine/solver.h"
+#include "heuristic/dlx.h"
+#include "heuristic/parallel.h"
+#include "serialization.h"
+#include "test.h"
+
+using sudoku_engine::Board;
+using sudoku_engine::BoardCage;
+using sudoku_engine::DlxHeuristic;
+using sudoku_engine::Heuristic;
+using sudoku_engine::ParallelHeuristic;
+using sudoku_engine::SearchBudget;
+using sudoku_engine::SearchStatus;
+using sudoku_engine::Solver;
+using sudoku_engine::serialization::MappedPuzzleLoader;
+using sudoku_engine::test::check;
+using sudoku_engine::test::getBundlePath;
+using sudoku_engine::test::getSearch;
+using sudoku_engine::test::loadPuzzle;
+using sudoku_engine::test::NamedSearch;
+using sudoku_engine::test::PUZZLE_COUNT;
+using sudoku_engine::test::STEP_LIMIT;
+
+using HeuristicFactory = std::function<std::unique_ptr<Heuristic>(Board&)>;
+
+struct NamedHeuristic {
+    std::string_view name;
+    HeuristicFactory factory;
+};
+
+static std::vector<NamedHeuristic> getHeuristics() {
+    const NamedSearch& forward = getSearch("forward-mrv");
+    const NamedSearch& propagate = getSearch("propagate");
+
+    return {
+        {forward.name, forward.factory},
+        {propagate.name, propagate.factory},
+        {"dlx",
+         [](Board& board) -> std::unique_ptr<Heuristic> {
+             return std::make_unique<DlxHeuristic>(board, STEP_LIMIT);
+         }},
+        // Solutions found by different workers add up to the same count
+        {"propagate --parallel 2",
+         [factory = propagate.factory](
+             Board& board
+         ) -> std::unique_ptr<Heuristic> {
+             return std::make_unique<ParallelHeuristic>(
+                 board, STEP_LIMIT, 2, factory
+             );
+         }}
+    };
+}
+
+struct CountResult {
+    SearchStatus status;
+    std::size_t solution_count;
+};
+
+static CountResult countSolutions(
+    Board& board,
+    Heuristic& heuristic,
+    std::span<const BoardCage> cages,
+    std::size_t solution_limit
+) {
+    loadPuzzle(cages, board, heuristic);
+
+    SearchBudget budget = heuristic.getBudget();
+    budget.solution_limit = solution_limit;
+    heuristic.setBudget(budget);
+
+    Solver solver;
+    const SearchStatus status = solver.solve(heuristic);
+    return {status, heuristic.getSolutionCount()};
+}
+
+// Searching through with a limit past any puzzle's count gives the exact
+// count, which every heuristic has to agree on. With some cages left out,
+// puzzles have more solutions to count.
+static std::vector<std::size_t> checkExactCounts(
+    const MappedPuzzleLoader& loader,
+    std::span<const NamedHeuristic> heuristics,
+    std::size_t dropped_cages
+) {
+    constexpr std::size_t SOLUTION_LIMIT = 100000;
+
+    std::vector<std::size_t> counts;
+    std::vector<BoardCage> cages;
+    for (std::size_t i = 0; i < PUZZLE_COUNT; i++) {
+        loader.view_puzzle(i).decode_cages(cages);
+        cages.resize(cages.size() - dropped_cages, BoardCage(0, {}));
+
+        std::optional<std::size_t> expected;
+        for (const NamedHeuristic& named : heuristics) {
+            Board board;
+            const auto heuristic = named.factory(board);
+            const CountResult result =
+                countSolutions(board, *heuristic, cages, SOLUTION_LIMIT);
+
+            const std::string what =
+                std::string(named.name) + " on puzzle " + std::to_string(i) +
+                " without " + std::to_string(dropped_cages) + " cages";
+            check(
+                result.status == SearchStatus::UNSATISFIABLE,
+                what + " didn't search through"
+            );
+            check(result.solution_count > 0, what + " found no solution");
+
+            if (!expected) {
+                expected = result.solution_count;
+            }
+            check(
+                result.solution_count == *expected,
+                what + " found " + std::to_string(result.solution_count) +
+                    " solutions, not " + std::to_string(*expected)
+            );
+        }
+        counts.push_back(expected.value_or(0));
+    }
+    return counts;
+}
+
+// The uniqueness check stops at a second solution, and only searches
+// through puzzles that have one
+static void checkUniqueness(
+    const MappedPuzzleLoader& loader,
+    const NamedHeuristic& named,
+    std::span<const std::size_t> exact_counts
+) {
+    Board board;
+    const auto heuristic = named.factory(board);
+    std::vector<BoardCage> cages;
+
+    for (std::size_t i = 0; i < PUZZLE_COUNT; i++) {
+        loader.view_puzzle(i).decode_cages(cages);
+        const CountResult result = countSolutions(board, *heuristic, cages, 2);
+
+        const bool is_unique = exact_counts[i] == 1;
+        const std::string what =
+            std::string(named.name) + " on puzzle " + std::to_string(i);
+        check(
+            result.status == (is_unique ? SearchStatus::UNSATISFIABLE :
+                                          SearchStatus::SOLVED),
+            what + " stopped early or late"
+        );
+        check(
+            result.solution_count == (is_unique ? 1 : 2),
+            what + " found " + std::to_string(result.solution_count) +
+                " solutions"
+        );
+    }
+}
+
+// A board without cages has more solutions than any limit, each of them a
+// valid grid
+static void checkLimit(const NamedHeuristic& named) {
+    Board board;
+    const auto heuristic = named.factory(board);
+
+    for (const std::size_t limit : {1, 2, 7}) {
+        const CountResult result = countSolutions(board, *heuristic, {}, limit);
+
+        const std::string what =
+            std::string(named.name) + " with limit " + std::to_string(limit);
+        check(result.status == SearchStatus::SOLVED, what + " unsolved");
+        check(
+            result.solution_count == limit,
+            what + " found " + std::to_string(result.solution_count) +
+                " solutions"
+        );
+        check(
+            !board.isIncomplete() && !board.isInvalid(),
+            what + " left an invalid board"
+        );
+    }
+}
+
+int main() {
+    const MappedPuzzleLoader loader(getBundlePath("cage-le-3.ks"));
+    const auto heuristics = getHeuristics();
+
+    const auto exact_counts = checkExactCounts(loader, heuristics, 0);
+    const auto loose_counts = checkExactCounts(loader, heuristics, 3);
+    // Some of the puzzles have to have several solutions to count
+    check(
+        std::ranges::max(loose_counts) > 2,
+        "No puzzle had more than two solutions"
+    );
+
+    for (const NamedHeuristic& named : heuristics) {
+        checkUniqueness(loader, named, exact_counts);
+        checkLimit(named);
+    }
+
+    return sudoku_engine::test::getExitStatus();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine/board.h"
+#include "heuristic/forward.h"
+#include "heuristic/propagation.h"
+#include "serialization.h"
+
+// Each test is an executable of its own, run by ctest, which fails it on a
+// non-zero exit status. Checks report what failed and carry on, so one run
+// shows every failure.
+namespace sudoku_engine::test {
+    inline int failure_count = 0;
+
+    inline void check(
+        bool condition,
+        std::string_view what,
+        std::source_location location = std::source_location::current()
+    ) {
+        if (!condition) {
+            std::cerr << location.file_name() << ':' << location.line()
+                      << ": " << what << std::endl;
+            failure_count++;
+        }
+    }
+
+    // What main() returns
+    inline int getExitStatus() {
+        return failure_count == 0 ? 0 : 1;
+    }
+
+    // Far more than any bundled puzzle takes
+    inline constexpr std::size_t STEP_LIMIT = 100000000;
+    // Puzzles from the front of a bundle that a test goes through
+    inline constexpr std::size_t PUZZLE_COUNT = 20;
+
+    using SearchPtr = std::unique_ptr<BacktrackHeuristic>;
+
+    struct NamedSearch {
+        std::string_view name;
+        std::function<SearchPtr(Board&)> factory;
+    };
+
+    // Backtracking searches under their command line names
+    inline const NamedSearch& getSearch(std::string_view name) {
+        using ValueOrder = ForwardHeuristic::ValueOrder;
+        using RestartSchedule = ForwardHeuristic::RestartSchedule;
+        using RestartPolicy = ForwardHeuristic::RestartPolicy;
+
+        const auto forward = [](ValueOrder order, RestartPolicy restarts) {
+            return [=](Board& board) -> SearchPtr {
+                return std::make_unique<ForwardHeuristic>(
+                    board, STEP_LIMIT, true, order, restarts
+                );
+            };
+        };
+        const auto propagate = [](ValueOrder order) {
+            return [=](Board& board) -> SearchPtr {
+                return std::make_unique<PropagationHeuristic>(
+                    board, STEP_LIMIT, order, RestartPolicy()
+                );
+            };
+        };
+
+        static const std::vector<NamedSearch> searches = {
+            {"forward-mrv", forward(ValueOrder::NATURAL, RestartPolicy())},
+            {"forward-mrv-lcv", forward(ValueOrder::LCV, RestartPolicy())},
+            {"forward-mrv-luby",
+             forward(
+                 ValueOrder::NATURAL,
+                 RestartPolicy{.schedule = RestartSchedule::LUBY}
+             )},
+            {"propagate", propagate(ValueOrder::NATURAL)},
+            {"propagate-alcv", propagate(ValueOrder::APPROX_LCV)}
+        };
+
+        for (const NamedSearch& search : searches) {
+            if (search.name == name) {
+                return search;
+            }
+        }
+        throw std::invalid_argument("No search named " + std::string(name));
+    }
+
+    inline std::string getBundlePath(std::string_view bundle) {
+        return std::string(SUDOKU_TEST_DATA_DIR) + '/' + std::string(bundle);
+    }
+
+    // Sets up an empty board with the cages and resets the heuristic on it
+    inline void loadPuzzle(
+        std::span<const BoardCage> cages,
+        Board& board,
+        Heuristic& heuristic
+    ) {
+        board.setCages(cages);
+        board.clearValues();
+        heuristic.reset();
+    }
+
+    // Decodes the cages into storage reused across puzzles
+    inline void loadPuzzle(
+        const serialization::MappedPuzzleLoader& loader,
+        std::size_t index,
+        Board& board,
+        Heuristic& heuristic,
+        std::vector<BoardCage>& cages
+    ) {
+        loader.view_puzzle(index).decode_cages(cages);
+        loadPuzzle(cages, board, heuristic);
+    }
+}
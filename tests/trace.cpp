@@ -0,0 +1,151 @@
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine/board.h"
+#include "engine/solver.h"
+#include "heuristic/trace.h"
+#include "serialization.h"
+#include "test.h"
+
+using sudoku_engine::Board;
+using sudoku_engine::BoardCage;
+using sudoku_engine::SearchStatus;
+using sudoku_engine::SearchTrace;
+using sudoku_engine::Solver;
+using sudoku_engine::TraceEvent;
+using sudoku_engine::TraceRecorder;
+using sudoku_engine::TraceReplayer;
+using sudoku_engine::serialization::MappedPuzzleLoader;
+using sudoku_engine::test::check;
+using sudoku_engine::test::getBundlePath;
+using sudoku_engine::test::getSearch;
+using sudoku_engine::test::loadPuzzle;
+using sudoku_engine::test::NamedSearch;
+using sudoku_engine::test::PUZZLE_COUNT;
+
+static constexpr std::size_t TRACE_CAPACITY = 1 << 20;
+
+static bool isSameEvents(const SearchTrace& a, const SearchTrace& b) {
+    return a.events.size() == b.events.size() &&
+           std::memcmp(
+               a.events.data(),
+               b.events.data(),
+               a.events.size() * sizeof(TraceEvent)
+           ) == 0;
+}
+
+// Replaying a whole trace has to end on the solution the search found, and
+// seeking back has to rebuild the same state as seeking forward
+static void checkReplay(
+    const MappedPuzzleLoader& loader,
+    const NamedSearch& search
+) {
+    Board board;
+    const auto heuristic = search.factory(board);
+    TraceRecorder recorder(TRACE_CAPACITY);
+    heuristic->setTraceRecorder(&recorder);
+
+    std::vector<BoardCage> cages;
+    for (std::size_t i = 0; i < PUZZLE_COUNT; i++) {
+        loadPuzzle(loader, i, board, *heuristic, cages);
+
+        const std::string what =
+            std::string(search.name) + " on puzzle " + std::to_string(i);
+        Solver solver;
+        // Puzzles can have several solutions, so the one found is only
+        // checked to be valid
+        check(
+            solver.solve(*heuristic) == SearchStatus::SOLVED &&
+                !board.isIncomplete() && !board.isInvalid(),
+            what + " unsolved"
+        );
+
+        const SearchTrace trace = recorder.getTrace();
+        check(trace.dropped_count == 0, what + " dropped events");
+        check(!trace.events.empty(), what + " recorded nothing");
+
+        try {
+            TraceReplayer replayer(trace);
+            replayer.seek(trace.events.size());
+            check(replayer.isDone(), what + " replay stopped early");
+            check(
+                replayer.getValues() == board.getValues(),
+                what + " replay didn't end on the board searched to"
+            );
+
+            const std::size_t middle = trace.events.size() / 2;
+            replayer.seek(middle);
+            const auto values = replayer.getValues();
+            const auto domains = replayer.getDomains();
+
+            TraceReplayer fresh(trace);
+            fresh.seek(middle);
+            check(
+                values == fresh.getValues() && domains == fresh.getDomains(),
+                what + " replay differs after seeking back"
+            );
+        } catch (const std::exception& e) {
+            check(false, what + " replay failed: " + e.what());
+        }
+
+        std::stringstream file;
+        trace.save(file);
+        const SearchTrace loaded = SearchTrace::load(file);
+        check(
+            loaded.initial_values == trace.initial_values &&
+                loaded.initial_domains == trace.initial_domains &&
+                loaded.dropped_count == trace.dropped_count &&
+                isSameEvents(loaded, trace),
+            what + " trace changed through a file"
+        );
+    }
+}
+
+// Once the ring wraps, the trace keeps the latest events but can no longer
+// be replayed from the initial board
+static void checkWrapped(const MappedPuzzleLoader& loader) {
+    constexpr std::size_t CAPACITY = 16;
+
+    Board board;
+    const auto heuristic = getSearch("propagate").factory(board);
+    TraceRecorder recorder(CAPACITY);
+    heuristic->setTraceRecorder(&recorder);
+
+    std::vector<BoardCage> cages;
+    loadPuzzle(loader, 0, board, *heuristic, cages);
+
+    Solver solver;
+    check(
+        solver.solve(*heuristic) == SearchStatus::SOLVED,
+        "Wrapped trace puzzle unsolved"
+    );
+
+    const SearchTrace trace = recorder.getTrace();
+    check(trace.events.size() == CAPACITY, "Wrapped trace has wrong size");
+    check(trace.dropped_count > 0, "Wrapped trace dropped nothing");
+
+    bool has_thrown = false;
+    try {
+        TraceReplayer replayer(trace);
+    } catch (const std::runtime_error&) {
+        has_thrown = true;
+    }
+    check(has_thrown, "Wrapped trace was replayed");
+}
+
+int main() {
+    const MappedPuzzleLoader loader(getBundlePath("cage-le-5.ks"));
+
+    for (const std::string_view name :
+         {"forward-mrv", "propagate", "propagate-alcv"}) {
+        checkReplay(loader, getSearch(name));
+    }
+    checkWrapped(loader);
+
+    return sudoku_engine::test::getExitStatus();
+}